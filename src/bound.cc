@@ -21,10 +21,8 @@
 
 using namespace std;
 
-int Bound::index_counter = 0;
-int Bound::total_frames = 0;
-
 Bound::Bound(const Bound& source) {
+   context = source.get_context();
    index = source.get_index();
    frame_num = source.get_frame_num();
    start_frame = source.get_start_frame();
@@ -33,6 +31,7 @@ Bound::Bound(const Bound& source) {
    dim = source.get_dim();
    utt_end = source.get_utt_end();
    phn_end = source.get_phn_end();
+   owns_frames = true;
    data = new float* [frame_num];
    for(int i = 0; i < frame_num; ++i) {
       data[i] = new float[dim];
@@ -41,9 +40,9 @@ Bound::Bound(const Bound& source) {
    }
    likelihoods = new float* [frame_num];
    for(int i = 0; i < frame_num; ++i) {
-      likelihoods[i] = new float[Cluster::counter];
+      likelihoods[i] = new float[context -> cluster_counter];
       const float* ptr = source.get_frame_i_likelihoods(i);
-      memcpy(likelihoods[i], ptr, sizeof(float) * Cluster::counter);
+      memcpy(likelihoods[i], ptr, sizeof(float) * context -> cluster_counter);
    }
    parent = source.get_parent();
 }
@@ -53,13 +52,16 @@ const Bound& Bound::operator= (const Bound& source) {
       return *this;
    }
    else {
-      for(int i = 0; i < frame_num; ++i) {
-         delete[] data[i];
-         delete[] likelihoods[i];
+      if (owns_frames) {
+         for(int i = 0; i < frame_num; ++i) {
+            delete[] data[i];
+            delete[] likelihoods[i];
+         }
       }
       delete[] data;
       delete[] likelihoods;
    }
+   context = source.get_context();
    index = source.get_index();
    frame_num = source.get_frame_num();
    start_frame = source.get_start_frame();
@@ -68,6 +70,7 @@ const Bound& Bound::operator= (const Bound& source) {
    utt_end = source.get_utt_end();
    phn_end = source.get_phn_end();
    parent = source.get_parent();
+   owns_frames = true;
    
    data = new float* [frame_num];
    for(int i = 0; i < frame_num; ++i) {
@@ -78,9 +81,9 @@ const Bound& Bound::operator= (const Bound& source) {
 
    likelihoods = new float* [frame_num];
    for(int i = 0; i < frame_num; ++i) {
-      likelihoods[i] = new float[Cluster::counter];
+      likelihoods[i] = new float[context -> cluster_counter];
       const float* ptr = source.get_frame_i_likelihoods(i);
-      memcpy(likelihoods[i], ptr, sizeof(float) * Cluster::counter);
+      memcpy(likelihoods[i], ptr, sizeof(float) * context -> cluster_counter);
    }
    return *this;
 }
@@ -88,7 +91,8 @@ const Bound& Bound::operator= (const Bound& source) {
 // Initialize a bound
 // give start_frame, end_frame, dim
 Bound::Bound(int start, int end, int d, \
-             bool s_utt_end) {
+             bool s_utt_end, RunContext* s_context) {
+   context = s_context;
    start_frame = start;
    end_frame = end;
    dim = d;
@@ -100,8 +104,30 @@ Bound::Bound(int start, int end, int d, \
       data[i] = new float[dim];
    }
    likelihoods = new float*[frame_num];
+   owns_frames = true;
    for(int i = 0; i < frame_num; ++i) {
-      likelihoods[i] = new float[Cluster::counter];
+      likelihoods[i] = new float[context -> cluster_counter];
+   }
+}
+
+// Initialize a bound whose frames (and their likelihoods) are rows of
+// matrices it does not own; only the row pointers are allocated
+Bound::Bound(int start, int end, int d, \
+             bool s_utt_end, RunContext* s_context, const float* frames, \
+             const float* s_likelihoods, int likelihood_dim, int s_frame_num) {
+   context = s_context;
+   start_frame = start;
+   end_frame = end;
+   dim = d;
+   frame_num = s_frame_num;
+   utt_end = s_utt_end;
+   phn_end = false;
+   owns_frames = false;
+   data = new float*[frame_num];
+   likelihoods = new float*[frame_num];
+   for(int i = 0; i < frame_num; ++i) {
+      data[i] = const_cast<float*>(frames + i * dim);
+      likelihoods[i] = const_cast<float*>(s_likelihoods + i * likelihood_dim);
    }
 }
 
@@ -114,18 +140,24 @@ void Bound::set_utt_end(bool s) {
 }
 
 void Bound::set_data(float** source) { 
+   if (!owns_frames) {
+      return;
+   }
    for(int i = 0; i < frame_num; ++i) {
       memcpy(data[i], source[i], sizeof(float) * dim);
    }
 }
 
 void Bound::set_likelihoods(float** source) { 
+   if (!owns_frames) {
+      return;
+   }
    for(int i = 0; i < frame_num; ++i) {
-      memcpy(likelihoods[i], source[i], sizeof(float) * Cluster::counter);
+      memcpy(likelihoods[i], source[i], sizeof(float) * context -> cluster_counter);
    }
 }
 
-void Bound::set_index(int id) {
+void Bound::set_index(frame_index_t id) {
    index = id;
 }
 
@@ -133,7 +165,7 @@ void Bound::set_parent(Segment* s_parent) {
    parent = s_parent;
 }
 
-void Bound::set_start_frame_index(const int index) {
+void Bound::set_start_frame_index(const frame_index_t index) {
    start_frame_index = index;
 }
 
@@ -147,9 +179,11 @@ void Bound::show_data() {
 }
 
 Bound::~Bound() {
-   for(int i = 0; i < frame_num; ++i) {
-      delete[] data[i];
-      delete[] likelihoods[i];
+   if (owns_frames) {
+      for(int i = 0; i < frame_num; ++i) {
+         delete[] data[i];
+         delete[] likelihoods[i];
+      }
    }
    delete[] data;
    delete[] likelihoods;
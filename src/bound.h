@@ -18,44 +18,52 @@
 #define BOUND_H
 
 #include "segment.h"
+#include "run_context.h"
+#include "frame_index.h"
 
 class Segment;
 class Bound {
    public:
-      static int index_counter;
-      static int total_frames;
-      Bound(int, int, int, bool);
+      Bound(int, int, int, bool, RunContext*);
+      // a bound over frames and likelihoods held elsewhere (a Corpus),
+      // which may hold fewer frames than the bound spans
+      Bound(int, int, int, bool, RunContext*, \
+        const float*, const float*, int, int);
       Bound(const Bound&);
       const Bound& operator= (const Bound&);
       void set_data(float**);
       void set_likelihoods(float**);
-      void set_index(int);
+      void set_index(frame_index_t);
       void set_parent(Segment*);
       void set_phn_end(bool);
       void set_utt_end(bool);
-      void set_start_frame_index(const int index);
+      void set_start_frame_index(const frame_index_t index);
       int get_frame_num() const {return frame_num;}
       int get_dim() const {return dim;}
-      int get_index() const {return index;}
+      frame_index_t get_index() const {return index;}
       int get_start_frame() const {return start_frame;}
       int get_end_frame() const {return end_frame;}
-      int get_start_frame_index() const {return start_frame_index;}
+      frame_index_t get_start_frame_index() const {return start_frame_index;}
       bool get_utt_end() const {return utt_end;}
       bool get_phn_end() const {return phn_end;}
       const float* get_frame_i_data(int i) const {return data[i];}
       const float* get_frame_i_likelihoods(int i) const {return likelihoods[i];}
       Segment* get_parent() const {return parent;}
+      RunContext* get_context() const {return context;}
       void show_data(); 
       ~Bound();
    private:
-      int index;
+      RunContext* context;
+      frame_index_t index;
       float** data;
       float** likelihoods;
       int frame_num;
       int start_frame;
-      int start_frame_index;
+      frame_index_t start_frame_index;
       int end_frame;
       int dim;
+      // false when data and likelihoods point into someone else's rows
+      bool owns_frames;
       bool utt_end;
       bool phn_end;
       Segment* parent;
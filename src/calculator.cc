@@ -83,5 +83,40 @@ float Calculator::find_log_max(vector<float> log_reg){
    return max;
 }
 
+// Uses the last n samples of every trace.
+double Calculator::scale_reduction(const vector<vector<double> >& traces, \
+                                   const int n) {
+   int m = traces.size();
+   if (m < 2 || n < 2) {
+      return 1.0;
+   }
+   vector<double> means(m, 0.0);
+   double grand_mean = 0.0;
+   double within = 0.0;
+   for (int c = 0; c < m; ++c) {
+      int first = traces[c].size() - n;
+      for (int i = first; i < first + n; ++i) {
+         means[c] += traces[c][i];
+      }
+      means[c] /= n;
+      grand_mean += means[c] / m;
+      double var = 0.0;
+      for (int i = first; i < first + n; ++i) {
+         var += (traces[c][i] - means[c]) * (traces[c][i] - means[c]);
+      }
+      within += var / (n - 1) / m;
+   }
+   double between = 0.0;
+   for (int c = 0; c < m; ++c) {
+      between += (means[c] - grand_mean) * (means[c] - grand_mean);
+   }
+   between *= (double) n / (m - 1);
+   if (within <= 0.0) {
+      return between > 0.0 ? HUGE_VAL : 1.0;
+   }
+   double pooled = (n - 1.0) / n * within + between / n;
+   return sqrt(pooled / within);
+}
+
 Calculator::~Calculator() {
 }
@@ -29,6 +29,9 @@ class Calculator {
       double sum_logs(double*, int);
       double find_log_max(vector<double>);
       float find_log_max(vector<float>);
+      // Gelman-Rubin potential scale reduction of equally long traces,
+      // one per chain; near 1 once the chains agree
+      double scale_reduction(const vector<vector<double> >&, const int);
       ~Calculator();
 };
 
@@ -0,0 +1,298 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./chain_runner.cc
+ *	FILE: chain_runner.cc                         *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <iostream>
+#include <sstream>
+#include <ctime>
+#include <algorithm>
+#include <mutex>
+#include <sys/stat.h>
+#include "chain_runner.h"
+
+using namespace std;
+
+// Stands in for cout's buffer while chains run. A thread with a prefix
+// set collects its output a line at a time and writes each line whole,
+// behind the prefix, so chains running side by side do not interleave;
+// without one, output goes straight through.
+class ChainLog : public streambuf {
+   public:
+      ChainLog(streambuf* s_console) {
+         console = s_console;
+      }
+      // the prefix of the calling thread; clearing it writes out what is
+      // left of the thread's line
+      static void set_prefix(ChainLog* log, const string& s) {
+         if (log != NULL && s == "" && line != "") {
+            log -> write_line();
+         }
+         prefix = s;
+      }
+      streambuf* get_console() const {return console;}
+   protected:
+      int overflow(int c) {
+         if (c == EOF) {
+            return 0;
+         }
+         char ch = c;
+         xsputn(&ch, 1);
+         return c;
+      }
+      streamsize xsputn(const char* s, streamsize n) {
+         if (prefix == "") {
+            lock_guard<mutex> lock(console_lock);
+            return console -> sputn(s, n);
+         }
+         line.append(s, n);
+         if (line[line.size() - 1] == '\n') {
+            write_line();
+         }
+         return n;
+      }
+   private:
+      void write_line() {
+         lock_guard<mutex> lock(console_lock);
+         size_t start = 0;
+         while (start < line.size()) {
+            size_t end = line.find('\n', start);
+            end = end == string::npos ? line.size() : end + 1;
+            console -> sputn(prefix.data(), prefix.size());
+            console -> sputn(line.data() + start, end - start);
+            start = end;
+         }
+         console -> pubsync();
+         line.clear();
+      }
+      streambuf* console;
+      mutex console_lock;
+      static thread_local string prefix;
+      static thread_local string line;
+};
+
+thread_local string ChainLog::prefix;
+thread_local string ChainLog::line;
+
+static string chain_prefix(const int c) {
+   stringstream prefix;
+   prefix << "[chain " << c << "] ";
+   return prefix.str();
+}
+
+// Runs one iteration of every chain.
+class ChainTask : public PoolTask {
+   public:
+      ChainTask(ChainRunner* s_runner, const int s_iter) {
+         runner = s_runner;
+         iter = s_iter;
+      }
+      void run(const int c, const int lane) {
+         runner -> run_chain(c, iter);
+      }
+   private:
+      ChainRunner* runner;
+      int iter;
+};
+
+ChainRunner::ChainRunner() {
+   chain_log = NULL;
+}
+
+bool ChainRunner::init(const vector<string>& configs, const int chain_num) {
+   if (configs.empty() || chain_num < 1) {
+      return false;
+   }
+   unsigned int clock_seed = time(NULL);
+   chain_log = new ChainLog(cout.rdbuf());
+   cout.rdbuf(chain_log);
+   for (int c = 0; c < chain_num; ++c) {
+      Manager* chain = new Manager();
+      chains.push_back(chain);
+      const string& config = configs[c % configs.size()];
+      if (!chain -> load_config(config)) {
+         cout << "Configuration file seems bad. Check " << config << endl;
+         return false;
+      }
+      // a sampler seeded with s also takes s + 1 and s + 2 for its
+      // storage pools, so chains step by three to keep every stream
+      // apart
+      unsigned int seed = chain -> get_seed() ? chain -> get_seed() : clock_seed;
+      chain -> set_seed(seed + 3 * c);
+      // the chains share one corpus, so they have to agree on how it
+      // is loaded
+      const char* key = NULL;
+      if (chain -> get_dim() != chains[0] -> get_dim()) {
+         key = "s_dim";
+      }
+      else if (chain -> get_frame_factor() != chains[0] -> get_frame_factor()) {
+         key = "s_frame_factor";
+      }
+      else if (chain -> get_frame_mode() != chains[0] -> get_frame_mode()) {
+         key = "s_frame_mode";
+      }
+      else if (chain -> get_merge_threshold() != \
+               chains[0] -> get_merge_threshold()) {
+         key = "s_merge_threshold";
+      }
+      else if (chain -> get_landmarks() != chains[0] -> get_landmarks()) {
+         key = "s_landmark_h1 (landmarks on or off)";
+      }
+      else if (chain -> get_landmark_dir() != chains[0] -> get_landmark_dir()) {
+         key = "s_landmark_dir";
+      }
+      if (key != NULL) {
+         cout << config << " disagrees with the first chain on " << key \
+           << endl;
+         return false;
+      }
+   }
+   // the configured threads of the first chain are split between the
+   // chains: a lane per chain, and what is left over inside each
+   int threads = chains[0] -> get_threads();
+   int lanes = min(threads, chain_num);
+   pool.init(lanes);
+   running.assign(chain_num, true);
+   segment_trace.resize(chain_num);
+   marginal_trace.resize(chain_num);
+   for (int c = 0; c < chain_num; ++c) {
+      chains[c] -> set_threads(max(1, threads / chain_num));
+      ChainLog::set_prefix(chain_log, chain_prefix(c));
+      chains[c] -> init_sampler();
+      ChainLog::set_prefix(chain_log, "");
+   }
+   cout << chain_num << " chains on " << lanes << " lanes of " \
+     << max(1, threads / chain_num) << " threads" << endl;
+   return true;
+}
+
+bool ChainRunner::load(const string& data_list, const string& snapshot, \
+                       const int batch_size) {
+   int likelihood_dim = 0;
+   if (snapshot != "") {
+      for (unsigned int c = 0; c < chains.size(); ++c) {
+         ChainLog::set_prefix(chain_log, chain_prefix(c));
+         bool loaded = chains[c] -> load_in_model(snapshot, 0);
+         ChainLog::set_prefix(chain_log, "");
+         int cluster_num = chains[c] -> get_context() -> cluster_counter;
+         if (cluster_num > likelihood_dim) {
+            likelihood_dim = cluster_num;
+         }
+         if (!loaded) {
+            cout << "Cannot load in snapshot" << endl;
+            return false;
+         }
+      }
+   }
+   chains[0] -> prepare_corpus(corpus);
+   if (!corpus.load(data_list, chains[0] -> get_dim(), snapshot != "", \
+     likelihood_dim)) {
+      return false;
+   }
+   for (unsigned int c = 0; c < chains.size(); ++c) {
+      cout << "Loading chain " << c << "..." << endl;
+      ChainLog::set_prefix(chain_log, chain_prefix(c));
+      bool loaded = snapshot != "" ? \
+        chains[c] -> load_in_data(corpus, batch_size) : \
+        chains[c] -> load_bounds(corpus, batch_size);
+      ChainLog::set_prefix(chain_log, "");
+      if (!loaded) {
+         return false;
+      }
+   }
+   return true;
+}
+
+void ChainRunner::run_chain(const int c, const int iter) {
+   if (running[c]) {
+      ChainLog::set_prefix(chain_log, chain_prefix(c));
+      bool sampled = chains[c] -> run_iteration(iter, chain_dirs[c]);
+      ChainLog::set_prefix(chain_log, "");
+      // the iteration a chain converges on still goes into its trace;
+      // after it, the chain has written its final snapshot and stops
+      if (sampled) {
+         record(c);
+      }
+      running[c] = sampled && !chains[c] -> has_converged();
+   }
+}
+
+void ChainRunner::record(const int c) {
+   segment_trace[c].push_back(chains[c] -> get_segment_num());
+   marginal_trace[c].push_back(chains[c] -> get_log_marginal());
+}
+
+// R-hat over the second half of the length all traces share, the first
+// taken as burn-in; chains that stopped early keep their last values.
+void ChainRunner::report(const int iter) {
+   unsigned int length = segment_trace[0].size();
+   for (unsigned int c = 1; c < chains.size(); ++c) {
+      length = min(length, (unsigned int) segment_trace[c].size());
+   }
+   int n = length / 2;
+   cout << "Chains after iteration " << iter << ":" << endl;
+   for (unsigned int c = 0; c < chains.size(); ++c) {
+      cout << "  chain " << c << " (seed " << chains[c] -> get_seed() \
+        << "): " << chains[c] -> get_segment_num() << " segments, " \
+        << chains[c] -> get_cluster_num() << " clusters, log marginal " \
+        << chains[c] -> get_log_marginal() << ", log joint " \
+        << chains[c] -> get_log_joint() \
+        << (chains[c] -> has_converged() ? " (converged)" : \
+          running[c] ? "" : " (stopped)") << endl;
+   }
+   if (n >= 2) {
+      cout << "  R-hat over the last " << n << " iterations: segments " \
+        << calculator.scale_reduction(segment_trace, n) \
+        << ", log marginal " \
+        << calculator.scale_reduction(marginal_trace, n) << endl;
+   }
+}
+
+void ChainRunner::run(const int num_iter, const string& result_dir) {
+   mkdir(result_dir.c_str(), 0755);
+   for (unsigned int c = 0; c < chains.size(); ++c) {
+      stringstream dir;
+      dir << result_dir << "/chain" << c;
+      mkdir(dir.str().c_str(), 0755);
+      chain_dirs.push_back(dir.str());
+   }
+   for (int i = 0; i <= num_iter; ++i) {
+      ChainTask task(this, i);
+      pool.parallel_for(chains.size(), task);
+      // stopped chains repeat their last values, so every trace has one
+      // entry per iteration
+      for (unsigned int c = 0; c < chains.size(); ++c) {
+         if ((int) segment_trace[c].size() <= i) {
+            record(c);
+         }
+      }
+      bool any_running = find(running.begin(), running.end(), true) != \
+        running.end();
+      if ((!(i % 100) && i != 0) || i == num_iter || !any_running) {
+         report(i);
+      }
+      if (!any_running) {
+         break;
+      }
+   }
+}
+
+ChainRunner::~ChainRunner() {
+   if (chain_log != NULL) {
+      cout.rdbuf(chain_log -> get_console());
+      delete chain_log;
+   }
+   // the corpus goes last, after the bounds over it
+   for (unsigned int c = 0; c < chains.size(); ++c) {
+      delete chains[c];
+   }
+}
@@ -0,0 +1,66 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./chain_runner.h
+ *	FILE: chain_runner.h                          *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef CHAIN_RUNNER_H
+#define CHAIN_RUNNER_H
+
+#include <string>
+#include <vector>
+#include "manager.h"
+#include "corpus.h"
+#include "thread_pool.h"
+#include "calculator.h"
+
+using namespace std;
+
+class ChainLog;
+
+// Several Gibbs chains over one corpus. Every chain has its own seed,
+// configuration, segments, clusters and run context; the frames are
+// loaded once, and the chains sample side by side as tasks on the
+// runner's pool. Each chain keeps a pool of its own for its share of the
+// threads: a pool runs one parallel_for at a time, so chains in flight
+// together cannot share one. Chain output is prefixed with the chain.
+class ChainRunner {
+   public:
+      ChainRunner();
+      // chain_num chains, chain c configured by configs[c % configs.size()]
+      // and seeded with its configured seed plus 3 * c
+      bool init(const vector<string>&, const int);
+      // one iteration of chain c; called from the pool
+      void run_chain(const int, const int);
+      // segment the data list from the prior, or from the labels of the
+      // list under the model of a snapshot when one is given
+      bool load(const string&, const string&, const int);
+      // results of chain c go to result_dir/chain<c>
+      void run(const int, const string&);
+      ~ChainRunner();
+   private:
+      void record(const int);
+      void report(const int);
+      Corpus corpus;
+      ThreadPool pool;
+      // cout's buffer while the runner lives; prefixes chain output
+      ChainLog* chain_log;
+      Calculator calculator;
+      vector<Manager*> chains;
+      vector<string> chain_dirs;
+      // not vector<bool>: chains set their own flag concurrently
+      vector<char> running;
+      // per chain, one value per iteration
+      vector<vector<double> > segment_trace;
+      vector<vector<double> > marginal_trace;
+};
+
+#endif
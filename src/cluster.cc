@@ -23,14 +23,12 @@
 
 using namespace std;
 
-int Cluster::counter = 0;
-int Cluster::aval_id = 0;
-
-Cluster::Cluster(int s_num, int v_dim) {
+Cluster::Cluster(int s_num, int v_dim, RunContext* s_context) : \
+  stats(s_num, s_context -> lane_num) {
 // Cluster::Cluster() {
+   context = s_context;
    state_num = s_num;
    vector_dim = v_dim;
-   member_num = 0;
    // trans = new float[state_num];
    for (int i = 0; i < state_num; ++i) {
       vector<float> state_trans;
@@ -39,15 +37,9 @@ Cluster::Cluster(int s_num, int v_dim) {
       }
       trans.push_back(state_trans);
    }
-   for (int i = 0; i < state_num; ++i) {
-      vector<float> state_trans;
-      for (int j = 0; j < state_num + 1; ++j) {
-         state_trans.push_back(0.0);
-      }
-      cache_trans.push_back(state_trans);
-   }
    id = -1;
    age = 0;
+   member_head = NULL;
 }
 
 void Cluster::init(const int s_state_num, \
@@ -67,15 +59,16 @@ void Cluster::init(const int s_state_num, \
 
 
 void Cluster::increase_trans(const int i, const int j) {
-   ++cache_trans[i][j];
+   stats.add_trans(i, j, 1);
 }
 
 void Cluster::decrease_trans(const int i, const int j) {
-   --cache_trans[i][j];
+   stats.add_trans(i, j, -1);
 }
 
 void Cluster::update_trans(vector<vector<float> > new_trans) {
    trans = new_trans;
+   drawn_counts = stats.get_trans();
 }
 
 void Cluster::append_member(Segment* data) {
@@ -89,7 +82,8 @@ void Cluster::append_member(Segment* data) {
    int i = frame_num - 1;
    int s_t = data -> get_hidden_states(i);
    increase_trans(s_t, state_num);
-   ++member_num;
+   stats.add_member_num(1);
+   link_member(data);
 }
 
 void Cluster::remove_members(Segment* data) {
@@ -103,7 +97,45 @@ void Cluster::remove_members(Segment* data) {
    int i = frame_num - 1;
    int s_t = data -> get_hidden_states(i);
    decrease_trans(s_t, state_num);
-   --member_num;
+   stats.add_member_num(-1);
+   if (data -> get_owner() == this) {
+      unlink_member(data);
+   }
+}
+
+void Cluster::link_member(Segment* data) {
+   if (data -> get_owner() == this) {
+      return;
+   }
+   if (data -> get_owner() != NULL) {
+      data -> get_owner() -> unlink_member(data);
+   }
+   lock_guard<mutex> lock(member_lock);
+   data -> set_owner(this);
+   data -> set_prev_member(NULL);
+   data -> set_next_member(member_head);
+   if (member_head != NULL) {
+      member_head -> set_prev_member(data);
+   }
+   member_head = data;
+}
+
+void Cluster::unlink_member(Segment* data) {
+   lock_guard<mutex> lock(member_lock);
+   Segment* prev = data -> get_prev_member();
+   Segment* next = data -> get_next_member();
+   if (prev != NULL) {
+      prev -> set_next_member(next);
+   }
+   else {
+      member_head = next;
+   }
+   if (next != NULL) {
+      next -> set_prev_member(prev);
+   }
+   data -> set_owner(NULL);
+   data -> set_prev_member(NULL);
+   data -> set_next_member(NULL);
 }
 
 void Cluster::set_cluster_id(int s_id) {
@@ -111,12 +143,12 @@ void Cluster::set_cluster_id(int s_id) {
 }
 
 void Cluster::set_cluster_id() {
-   id = aval_id;
-   aval_id++;
+   id = context -> aval_id;
+   context -> aval_id++;
 }
 
 int Cluster::get_member_num() const {
-   return member_num;
+   return stats.get_member_num();
 }
 
 int Cluster::get_cluster_id() const {
@@ -125,49 +157,73 @@ int Cluster::get_cluster_id() const {
 
 // Compute P(d|HMM)
 double Cluster::compute_likelihood(const Segment& data){
+   int frame_num = data.get_frame_num();
+   double score;
+   compute_span_likelihoods(data.get_frame_likelihood_rows(), 1, \
+     &frame_num, &score);
+   return score;
+}
+
+void Cluster::compute_span_likelihoods(const float* const* frames, \
+                                       const int span_num, \
+                                       const int* ends, double* scores) {
+   if (context -> semiring == SEMIRING_MAX) {
+      span_likelihoods<MaxProduct>(frames, span_num, ends, scores);
+   }
+   else {
+      span_likelihoods<SumProduct>(frames, span_num, ends, scores);
+   }
+}
+
+// The forward recursion over the states, read out whenever it has taken
+// in as many frames as the next span holds. A span of one frame is in
+// the first state; longer ones end in the last.
+template <class Semiring>
+void Cluster::span_likelihoods(const float* const* frames, \
+                               const int span_num, \
+                               const int* ends, double* scores) {
    double cur_scores[state_num];
    double pre_scores[state_num];
    for (int i = 0; i < state_num; ++i) {
       cur_scores[i] = 0.0;
       pre_scores[i] = 0.0;
    }
-   
+   int span = 0;
    // frame 0, state 0 (fixed)
-   pre_scores[0] = compute_emission_likelihood(0, data.get_frame_i_likelihoods(0));
-   if (data.get_frame_num() > 1) {
-     // frame 1, all states (coming from state 0)
-     for (int cur_state = 0; cur_state < state_num; ++cur_state) {
-       double prob_emit = compute_emission_likelihood(cur_state, data.get_frame_i_likelihoods(1));
-       cur_scores[cur_state] = pre_scores[0] + prob_emit + trans[0][curr_state]; 
-     }
-
-     // pre_scores are now frame 1
-     for (int i = 0; i < state_num; ++i) {
-       pre_scores[i] = cur_scores[i];
-     }
-
-      for (int i = 2; i < data.get_frame_num(); ++i) {
-	// next frame, all states
-	for (int cur_state = 0; cur_state < state_num; ++cur_state) {
-	  for(int pre_state = 0; pre_state <= curr_state; pre_state++){
-	    pre_scores[pre_state] += trans[pre_state][curr_state];
-	  }
-	  cur_scores[cur_state] = calculator.sum_logs(pre_scores, cur_state + 1);
-	  double prob_emit_i = compute_emission_likelihood(cur_state, data.get_frame_i_likelihoods(i));
-	  cur_scores[cur_state] += prob_emit_i;
-	}
-	// update pre_scores
-	for (int j = 0; j < state_num; ++j ) {
-	  pre_scores[j] = cur_scores[j];
-	}
-      }
+   pre_scores[0] = compute_emission_likelihood(0, frames[0]);
+   for (; span < span_num && ends[span] == 1; ++span) {
+      scores[span] = pre_scores[0];
+   }
+   if (span == span_num) {
+      return;
    }
-   // more than 1 frame has to end in last state
-   if (data.get_frame_num() > 1) {
-      return pre_scores[state_num - 1]; // + log(trans[state_num - 1][state_num]); 
+   // frame 1, all states (coming from state 0)
+   for (int cur_state = 0; cur_state < state_num; ++cur_state) {
+      double prob_emit = compute_emission_likelihood(cur_state, frames[1]);
+      cur_scores[cur_state] = pre_scores[0] + prob_emit + trans[0][cur_state];
+   }
+   for (int i = 0; i < state_num; ++i) {
+      pre_scores[i] = cur_scores[i];
    }
-   else { // first frame is in first state
-     return pre_scores[0]; // + log(trans[0][state_num]);
+   for (; span < span_num && ends[span] == 2; ++span) {
+      scores[span] = pre_scores[state_num - 1];
+   }
+   for (int i = 2; span < span_num; ++i) {
+      for (int cur_state = 0; cur_state < state_num; ++cur_state) {
+         for (int pre_state = 0; pre_state <= cur_state; pre_state++) {
+            pre_scores[pre_state] += trans[pre_state][cur_state];
+         }
+         cur_scores[cur_state] = Semiring::plus(calculator, pre_scores, \
+           cur_state + 1);
+         cur_scores[cur_state] += \
+           compute_emission_likelihood(cur_state, frames[i]);
+      }
+      for (int j = 0; j < state_num; ++j) {
+         pre_scores[j] = cur_scores[j];
+      }
+      for (; span < span_num && ends[span] == i + 1; ++span) {
+         scores[span] = pre_scores[state_num - 1];
+      }
    }
 }
 
@@ -176,7 +232,7 @@ double Cluster::compute_emission_likelihood(int state, const float* likelihoods)
   // likelihoods = P(state|data) = P(data|state)*P(state)/P(data)
   // P(data) is the same for all computations, so doesn't matter
   // assuming for now that P(state) also doesn't matter (i.e. is uniform), which gives P(state|data) ~ P(data|state)
-  return likelihoods[counter*state + id]; //NOTE: this has to change with DP 
+  return likelihoods[context -> cluster_counter*state + id]; //NOTE: this has to change with DP 
 }
 
 vector<vector<float> > Cluster::compute_forward_prob(Segment& data) {
@@ -325,6 +381,17 @@ void Cluster::set_trans(const float* s_trans) {
          trans[i][j] = s_trans[i * (state_num + 1) + j];
       }
    }
+   drawn_counts = stats.get_trans();
+}
+
+void Cluster::set_trans(const float* s_trans, \
+                        const vector<vector<float> >& counts) {
+   set_trans(s_trans);
+   drawn_counts = counts;
+}
+
+void Cluster::fold_counts() {
+   stats.fold();
 }
 
 float Cluster::get_state_trans_prob(int from, int to) const {
@@ -332,13 +399,18 @@ float Cluster::get_state_trans_prob(int from, int to) const {
 }
 
 void Cluster::show_member_len() {
+   int frame_num = 0;
+   for (Segment* ptr = member_head; ptr != NULL; ptr = ptr -> get_next_member()) {
+      frame_num += ptr -> get_frame_num();
+   }
    cout << "I am Cluster " << id << 
-     " and I have " << member_num << " members." << endl;
+     " and I have " << get_member_num() << " members covering " << 
+     frame_num << " frames." << endl;
 }
 void Cluster::state_snapshot(const string& fn) {
    ofstream fout(fn.c_str(), ios::app);
    // write out members' info
-   int member_len = member_num; 
+   int member_len = get_member_num(); 
    // write out member number
    fout.write(reinterpret_cast<char*> (&member_len), sizeof(int));
    // write state number
@@ -395,6 +467,9 @@ void Cluster::state_snapshot(const string& fn) {
 }
 
 Cluster::~Cluster(){
+   while (member_head != NULL) {
+      unlink_member(member_head);
+   }
    /*
    if (id != -1) {
       cout << "cluster " << id << " has been destructed" << endl;
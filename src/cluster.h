@@ -20,27 +20,37 @@
 #include <iostream> 
 #include <vector>
 #include <list>
+#include <mutex>
 #include "segment.h"
 #include "calculator.h"
+#include "suff_stats.h"
+#include "run_context.h"
 
 using namespace std;
 
 class Cluster {
    public:
-      Cluster(int, int);
-      static int counter;
-      static int aval_id;
+      Cluster(int, int, RunContext*);
       // Update model parameters:
       // transition prob
       void init(const int, const int);
       void update_trans(vector<vector<float> >);
       void append_member(Segment*);
       void remove_members(Segment*);
+      // member list, walk with Segment::get_next_member()
+      Segment* get_first_member() const {return member_head;}
+      void link_member(Segment*);
+      void unlink_member(Segment*);
       void set_cluster_id();
       void set_cluster_id(int);
       int get_member_num() const;
       int get_cluster_id() const;
       double compute_likelihood(const Segment&);
+      // compute_likelihood of the spans of the given frames that end
+      // after each of the given (increasing) frame counts, in one pass,
+      // in the semiring of the run
+      void compute_span_likelihoods(const float* const*, const int, \
+        const int*, double*);
       double compute_emission_likelihood(int, const float*);
       float get_state_trans_prob(int, int) const;
       int get_state_num() const { return state_num; }
@@ -56,20 +66,41 @@ class Cluster {
       void increase_trans(const int, const int);
       void decrease_trans(const int, const int);
       void set_trans(const float*);
-      void set_member_num(const int s_member_num) {member_num = s_member_num;}
+      // install a table drawn from the given counts; the cluster stays
+      // dirty if its counts have moved from them since
+      void set_trans(const float*, const vector<vector<float> >&);
+      // publish count changes from a lane, see SuffStats
+      void publish_counts(const int s_lane, const float* s_trans, \
+        const int s_member_num) {stats.publish(s_lane, s_trans, s_member_num);}
+      // take published counts in; must not run alongside publishing
+      void fold_counts();
+      void set_member_num(const int s_member_num) {stats.set_member_num(s_member_num);}
       int get_age() const {return age;}
-      vector<vector<float> >& get_cache_trans() { return cache_trans;}
+      // net counts differ from those the transition table was drawn
+      // from; a segment taken out and put back leaves it clean
+      bool is_dirty() const {return stats.get_trans() != drawn_counts;}
+      vector<vector<float> >& get_cache_trans() { return stats.get_trans();}
       ~Cluster();
    private:
+      RunContext* context;
       // Store the cluster id
       int id;
       int age;
       int state_num;
       int vector_dim;
-      int member_num;
+      // transition counts the installed table was drawn from
+      vector<vector<float> > drawn_counts;
       vector<vector<float> > trans;
-      vector<vector<float> > cache_trans;
+      template <class Semiring>
+      void span_likelihoods(const float* const*, const int, const int*, \
+        double*);
+      // transition counts and member count
+      SuffStats stats;
       // Store segments that belong to this cluster.
+      Segment* member_head;
+      // guards the member list; utterances sampled in parallel link and
+      // unlink their own segments concurrently
+      mutex member_lock;
       // Utilities
       Calculator calculator;
 };
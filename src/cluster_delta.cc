@@ -0,0 +1,73 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./cluster_delta.cc
+ *	FILE: cluster_delta.cc                        *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include "cluster_delta.h"
+
+ClusterDelta::ClusterDelta() {
+   state_num = 0;
+   segment_num = 0;
+}
+
+// An utterance touches few clusters, so a linear scan beats a map.
+int ClusterDelta::find_entry(const Cluster* model) const {
+   for (unsigned int e = 0; e < models.size(); ++e) {
+      if (models[e] == model) {
+         return e;
+      }
+   }
+   return -1;
+}
+
+void ClusterDelta::change_member(Cluster* model, \
+                                 const Segment* data, \
+                                 const int sign) {
+   int row_len = state_num + 1;
+   int e = find_entry(model);
+   if (e == -1) {
+      e = models.size();
+      models.push_back(model);
+      member_nums.push_back(0);
+      trans.resize(trans.size() + state_num * row_len, 0.0);
+   }
+   float* table = &trans[e * state_num * row_len];
+   // same transitions as Cluster::append_member
+   int frame_num = data -> get_frame_num();
+   for (int i = 0; i < frame_num - 1; ++i) {
+      int s_t = data -> get_hidden_states(i);
+      int s_t_1 = data -> get_hidden_states(i + 1);
+      table[s_t * row_len + s_t_1] += sign;
+   }
+   int s_t = data -> get_hidden_states(frame_num - 1);
+   table[s_t * row_len + state_num] += sign;
+   member_nums[e] += sign;
+}
+
+int ClusterDelta::get_member_num(const Cluster* model) const {
+   int e = find_entry(model);
+   return e == -1 ? 0 : member_nums[e];
+}
+
+void ClusterDelta::publish(const int lane) {
+   int table_len = state_num * (state_num + 1);
+   for (unsigned int e = 0; e < models.size(); ++e) {
+      models[e] -> publish_counts(lane, &trans[e * table_len], member_nums[e]);
+   }
+}
+
+void ClusterDelta::clear() {
+   models.clear();
+   member_nums.clear();
+   trans.clear();
+   segment_num = 0;
+}
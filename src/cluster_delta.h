@@ -0,0 +1,55 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./cluster_delta.h
+ *	FILE: cluster_delta.h                         *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef CLUSTER_DELTA_H
+#define CLUSTER_DELTA_H
+
+#include <vector>
+#include "cluster.h"
+#include "segment.h"
+
+using namespace std;
+
+// Count changes made while one utterance is sampled in parallel with
+// others. The shared counts are left alone until the changes are
+// published and folded; in the meantime the sampler reads the shared
+// counts plus this overlay.
+class ClusterDelta {
+   public:
+      ClusterDelta();
+      void set_state_num(const int s) {state_num = s;}
+      // count a segment into (sign 1) or out of (sign -1) a cluster
+      void change_member(Cluster*, const Segment*, const int);
+      void change_segment_num(const int d) {segment_num += d;}
+      int get_member_num(const Cluster*) const;
+      int get_segment_num() const {return segment_num;}
+      // hand the cluster count changes to the clusters' shards of the
+      // given lane; they count once the clusters are folded
+      void publish(const int);
+      // clusters touched since the last clear
+      const vector<Cluster*>& get_models() const {return models;}
+      void clear();
+      ~ClusterDelta() {};
+   private:
+      int find_entry(const Cluster*) const;
+      int state_num;
+      int segment_num;
+      // one entry per touched cluster, with its member count change and
+      // a state_num x (state_num + 1) table of transition count changes
+      vector<Cluster*> models;
+      vector<int> member_nums;
+      vector<float> trans;
+};
+
+#endif
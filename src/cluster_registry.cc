@@ -0,0 +1,85 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./cluster_registry.cc
+ *	FILE: cluster_registry.cc                     *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <iostream>
+#include "cluster_registry.h"
+
+using namespace std;
+
+ClusterRegistry::ClusterRegistry() {
+}
+
+void ClusterRegistry::insert(Cluster* model) {
+   int id = model -> get_cluster_id();
+   if (id < 0) {
+      cout << "Cannot register a cluster without an id" << endl;
+      return;
+   }
+   if (id >= (int) slots.size()) {
+      Slot empty_slot;
+      empty_slot.dense_index = -1;
+      empty_slot.generation = 0;
+      slots.resize(id + 1, empty_slot);
+   }
+   if (slots[id].dense_index != -1) {
+      // already registered
+      return;
+   }
+   slots[id].dense_index = dense.size();
+   dense.push_back(model);
+}
+
+bool ClusterRegistry::remove(const int id) {
+   if (id < 0 || id >= (int) slots.size() || slots[id].dense_index == -1) {
+      return false;
+   }
+   int hole = slots[id].dense_index;
+   Cluster* last = dense.back();
+   dense[hole] = last;
+   slots[last -> get_cluster_id()].dense_index = hole;
+   dense.pop_back();
+   slots[id].dense_index = -1;
+   ++slots[id].generation;
+   return true;
+}
+
+Cluster* ClusterRegistry::find(const int id) const {
+   if (id < 0 || id >= (int) slots.size() || slots[id].dense_index == -1) {
+      return NULL;
+   }
+   return dense[slots[id].dense_index];
+}
+
+Cluster* ClusterRegistry::find(const int id, \
+                               const unsigned int generation) const {
+   if (get_generation(id) != generation) {
+      return NULL;
+   }
+   return find(id);
+}
+
+unsigned int ClusterRegistry::get_generation(const int id) const {
+   if (id < 0 || id >= (int) slots.size()) {
+      return 0;
+   }
+   return slots[id].generation;
+}
+
+void ClusterRegistry::clear() {
+   slots.clear();
+   dense.clear();
+}
+
+ClusterRegistry::~ClusterRegistry() {
+}
@@ -0,0 +1,57 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./cluster_registry.h
+ *	FILE: cluster_registry.h                      *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef CLUSTER_REGISTRY_H
+#define CLUSTER_REGISTRY_H
+
+#include <vector>
+#include "cluster.h"
+
+using namespace std;
+
+// Keeps track of the live clusters.
+// A slot table indexed by cluster id points into a dense array of
+// clusters, so lookup and removal by id are O(1) and the scoring loops
+// can still walk a contiguous vector. Removal swaps the last cluster
+// into the hole, so the dense order is not stable across removals.
+// Every slot carries a generation that is bumped whenever the id is
+// retired, which lets callers holding (id, generation) detect a stale
+// reference.
+class ClusterRegistry {
+   public:
+      ClusterRegistry();
+      // Register a cluster that already has an id
+      void insert(Cluster*);
+      // Drop the cluster with the given id (the cluster is not deleted)
+      bool remove(const int);
+      Cluster* find(const int) const;
+      Cluster* find(const int, const unsigned int) const;
+      unsigned int get_generation(const int) const;
+      unsigned int size() const {return dense.size();}
+      bool empty() const {return dense.empty();}
+      Cluster* operator[] (const unsigned int i) const {return dense[i];}
+      vector<Cluster*>::iterator begin() {return dense.begin();}
+      vector<Cluster*>::iterator end() {return dense.end();}
+      void clear();
+      ~ClusterRegistry();
+   private:
+      struct Slot {
+         int dense_index;
+         unsigned int generation;
+      };
+      vector<Slot> slots;
+      vector<Cluster*> dense;
+};
+
+#endif
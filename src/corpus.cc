@@ -0,0 +1,329 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./corpus.cc
+ *	FILE: corpus.cc                               *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include "corpus.h"
+#include "local_seg.h"
+
+using namespace std;
+
+static string file_basename(const string& s) {
+   size_t found_last_slash, found_last_period;
+   found_last_slash = s.find_last_of("/");
+   found_last_period = s.find_last_of(".");
+   return s.substr(found_last_slash + 1, \
+     found_last_period - 1 - found_last_slash);
+}
+
+Corpus::Corpus() {
+   dim = 0;
+   likelihood_dim = 0;
+   labelled = false;
+   frame_num = 0;
+   frame_factor = 1;
+   frame_mode = FRAME_AVERAGE;
+   merge_threshold = 0.0;
+   candidate_num = 0;
+   use_landmarks = false;
+}
+
+void Corpus::set_merge_threshold(const float threshold) {
+   merge_threshold = threshold;
+}
+
+void Corpus::set_landmarks(const bool use, const string& dir) {
+   use_landmarks = use;
+   landmark_dir = dir;
+}
+
+void Corpus::set_frame_reduction(const int factor, const int mode) {
+   frame_factor = factor > 1 ? factor : 1;
+   frame_mode = mode;
+}
+
+void Corpus::clear() {
+   basenames.clear();
+   utt_first.clear();
+   starts.clear();
+   ends.clear();
+   labels.clear();
+   frame_counts.clear();
+   landmarks.clear();
+   frame_index.clear();
+   frames.clear();
+   likelihoods.clear();
+   frame_num = 0;
+   candidate_num = 0;
+}
+
+bool Corpus::load(const string& fnbound_list, const int s_dim, \
+                  const bool s_labelled, const int s_likelihood_dim) {
+   clear();
+   dim = s_dim;
+   labelled = s_labelled;
+   likelihood_dim = s_likelihood_dim;
+
+   ifstream fbound_list(fnbound_list.c_str(), ifstream::in);
+   if (!fbound_list.is_open()) {
+      return false;
+   }
+   cout << "file opened" << endl;
+   vector<string> fn_indices;
+   vector<string> fn_datas;
+   while (fbound_list.good()) {
+      string fn_index;
+      string fn_data;
+      fbound_list >> fn_index;
+      fbound_list >> fn_data;
+      if (fn_index != "" && fn_data != "") {
+         fn_indices.push_back(fn_index);
+         fn_datas.push_back(fn_data);
+      }
+   }
+   fbound_list.close();
+
+   // size the frame matrix from the data files up front, so that it is
+   // never reallocated (and briefly held twice) while it fills
+   size_t float_num = 0;
+   for (unsigned int u = 0; u < fn_datas.size(); ++u) {
+      ifstream fdata(fn_datas[u].c_str(), ifstream::binary | ifstream::ate);
+      if (!fdata.is_open()) {
+         cout << "Cannot open " << fn_datas[u] << endl;
+         return false;
+      }
+      float_num += fdata.tellg() / sizeof(float);
+   }
+   // a reduced bound may round up by a frame, which is left to grow into
+   frames.reserve(float_num / frame_factor);
+   vector<float> raw;
+   frame_index_t raw_frame_num = 0;
+   // frames have to be addressable as floats, and through a
+   // frame_index_t; on 64-bit hosts the first bound is the smaller
+   frame_index_t max_frames = FRAME_INDEX_MAX;
+   if (SIZE_MAX / sizeof(float) / (dim + likelihood_dim) < (uint64_t) max_frames) {
+      max_frames = SIZE_MAX / sizeof(float) / (dim + likelihood_dim);
+   }
+
+   for (unsigned int u = 0; u < fn_indices.size(); ++u) {
+      ifstream findex(fn_indices[u].c_str(), ifstream::in);
+      ifstream fdata(fn_datas[u].c_str(), ifstream::binary);
+      if (!findex.is_open() || !fdata.is_open()) {
+         return false;
+      }
+      cout << "Loading " << fn_indices[u] << "..." << endl;
+      int total_frame_num;
+      if (!(findex >> total_frame_num) || total_frame_num <= 0) {
+         cout << fn_indices[u] << ": the frame count is not a positive int" \
+           << endl;
+         return false;
+      }
+      frame_index_t first = starts.size();
+      int start = 0;
+      int end = -1;
+      int cluster_label = -1;
+      while (end != total_frame_num - 1) {
+         int prev_end = end;
+         if (!(findex >> start >> end) || \
+             (labelled && !(findex >> cluster_label))) {
+            cout << fn_indices[u] << ": bounds stop at frame " << prev_end \
+              << " of " << total_frame_num << endl;
+            return false;
+         }
+         // bounds tile the utterance; an empty one ends before it starts
+         if (start != prev_end + 1 || end < start - 1 || \
+             end >= total_frame_num) {
+            cout << fn_indices[u] << ": bound " << start << " " << end \
+              << " does not follow frame " << prev_end << " within " \
+              << total_frame_num << " frames" << endl;
+            return false;
+         }
+         int bound_frame_num = end - start + 1;
+         if (bound_frame_num == 0) {
+            continue;
+         }
+         if (frame_num > max_frames - bound_frame_num) {
+            cout << fn_indices[u] << ": the corpus outgrows " \
+              << max_frames << " frames" << endl;
+            return false;
+         }
+         size_t offset = frames.size();
+         size_t bytes = sizeof(float) * bound_frame_num * dim;
+         raw.resize((size_t) bound_frame_num * dim);
+         fdata.read(reinterpret_cast<char*>(&raw[0]), bytes);
+         if ((size_t) fdata.gcount() != bytes) {
+            cout << fn_datas[u] << " ends before frame " << end << endl;
+            return false;
+         }
+         if (frame_factor > 1) {
+            reduce_frames(&raw[0], bound_frame_num);
+         }
+         else {
+            frames.insert(frames.end(), raw.begin(), raw.end());
+         }
+         int count = (frames.size() - offset) / dim;
+         raw_frame_num += bound_frame_num;
+         ++candidate_num;
+         // a bound whose first frame is too like the last one before it
+         // joins the bound before, unless a labelled phone ends there
+         if (merge_threshold > 0 && (frame_index_t) starts.size() > first && \
+             (!labelled || labels.back() == -1) && \
+             edge_similarity(frame_num - 1) > merge_threshold) {
+            ends.back() = end;
+            labels.back() = cluster_label;
+            frame_counts.back() += count;
+         }
+         else {
+            starts.push_back(start);
+            ends.push_back(end);
+            labels.push_back(cluster_label);
+            frame_counts.push_back(count);
+            frame_index.push_back(frame_num);
+         }
+         frame_num += count;
+      }
+      findex.close();
+      fdata.close();
+      if ((frame_index_t) starts.size() == first) {
+         cout << fn_indices[u] << " has no frames, skipped." << endl;
+         continue;
+      }
+      basenames.push_back(file_basename(fn_datas[u]));
+      utt_first.push_back(first);
+   }
+   utt_first.push_back(starts.size());
+   likelihoods.assign((size_t) frame_num * likelihood_dim, 0.0);
+   cout << "Corpus of " << basenames.size() << " utterances, " \
+     << frame_num << " frames (" << frames.size() * sizeof(float) / 1048576 \
+     << " MB)" << endl;
+   if (frame_factor > 1) {
+      cout << "Frames reduced " << frame_factor << " to 1 by " \
+        << (frame_mode == FRAME_SUBSAMPLE ? "subsampling" : "averaging") \
+        << ", from " << raw_frame_num << endl;
+   }
+   if (use_landmarks) {
+      if (landmark_dir != "") {
+         if (!read_landmarks()) {
+            return false;
+         }
+      }
+      else {
+         find_landmarks();
+      }
+      cout << "Landmarks at " << count(landmarks.begin(), landmarks.end(), 1) \
+        << " of " << starts.size() << " bounds" << endl;
+   }
+   if (merge_threshold > 0) {
+      cout << "Merged bounds of edge similarity above " << merge_threshold \
+        << ": " << starts.size() << " of " << candidate_num \
+        << " candidates left (reduction ratio " \
+        << (candidate_num ? 1.0 - (double) starts.size() / candidate_num : 0.0) \
+        << ")" << endl;
+   }
+   return true;
+}
+
+// Local_seg writes one line per edge between neighbouring frames of the
+// data files, 1 at a landmark.
+bool Corpus::read_landmarks() {
+   landmarks.assign(starts.size(), 0);
+   for (int u = 0; u < get_utterance_num(); ++u) {
+      string fn = landmark_dir + "/" + basenames[u] + ".lm";
+      ifstream flandmarks(fn.c_str(), ifstream::in);
+      if (!flandmarks.is_open()) {
+         cout << "Cannot open " << fn << endl;
+         return false;
+      }
+      vector<char> edges;
+      string line;
+      while (getline(flandmarks, line)) {
+         if (line != "") {
+            edges.push_back(line[0] == '1');
+         }
+      }
+      for (frame_index_t b = utt_first[u]; b < utt_first[u + 1]; ++b) {
+         if (ends[b] < (int) edges.size()) {
+            landmarks[b] = edges[ends[b]];
+         }
+      }
+   }
+   return true;
+}
+
+// The landmarks of Local_seg, over the frames of every utterance as
+// loaded.
+void Corpus::find_landmarks() {
+   landmarks.assign(starts.size(), 0);
+   for (int u = 0; u < get_utterance_num(); ++u) {
+      frame_index_t first = frame_index[utt_first[u]];
+      frame_index_t last_bound = utt_first[u + 1] - 1;
+      int edge_num = frame_index[last_bound] + frame_counts[last_bound] - \
+        first - 1;
+      vector<double> scores(edge_num);
+      for (int e = 0; e < edge_num; ++e) {
+         scores[e] = edge_similarity(first + e);
+      }
+      vector<char> minima;
+      Local_seg::find_local_min(scores.data(), edge_num, minima);
+      for (frame_index_t b = utt_first[u]; b < last_bound; ++b) {
+         landmarks[b] = minima[frame_index[b] + frame_counts[b] - 1 - first];
+      }
+   }
+}
+
+// Cosine similarity of frames f and f + 1, as Local_seg::self_align
+// scores neighbouring frames.
+double Corpus::edge_similarity(const frame_index_t f) const {
+   const float* a = get_frame(f);
+   const float* b = get_frame(f + 1);
+   double dot = 0.0, a_len = 0.0, b_len = 0.0;
+   for (int d = 0; d < dim; ++d) {
+      dot += a[d] * b[d];
+      a_len += a[d] * a[d];
+      b_len += b[d] * b[d];
+   }
+   if (a_len == 0.0 || b_len == 0.0) {
+      return 0.0;
+   }
+   return dot / sqrt(a_len * b_len);
+}
+
+// Frames are reduced within a bound, so bounds keep their edges and the
+// last frame of a bound may stand for fewer than frame_factor frames.
+// The frames are posteriors, averaged as logs: the geometric mean.
+void Corpus::reduce_frames(const float* raw, const int raw_num) {
+   const double floor = 1e-10;
+   for (int first = 0; first < raw_num; first += frame_factor) {
+      int len = min(frame_factor, raw_num - first);
+      size_t offset = frames.size();
+      frames.insert(frames.end(), raw + (size_t) first * dim, \
+        raw + (size_t) (first + 1) * dim);
+      if (frame_mode == FRAME_SUBSAMPLE || len == 1) {
+         continue;
+      }
+      for (int d = 0; d < dim; ++d) {
+         double log_sum = 0.0;
+         for (int i = first; i < first + len; ++i) {
+            log_sum += log(max((double) raw[(size_t) i * dim + d], floor));
+         }
+         frames[offset + d] = exp(log_sum / len);
+      }
+   }
+}
+
+Corpus::~Corpus() {
+}
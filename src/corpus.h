@@ -0,0 +1,109 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./corpus.h
+ *	FILE: corpus.h                                *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <string>
+#include <vector>
+#include "frame_index.h"
+
+using namespace std;
+
+// how a corpus brings every frame_factor frames of a bound down to one
+#define FRAME_AVERAGE 0
+#define FRAME_SUBSAMPLE 1
+
+// Every frame of a data list, read once into one matrix. Bounds built
+// from a corpus point into it rather than copying their frames, so any
+// number of samplers can share one loaded corpus read-only.
+class Corpus {
+   public:
+      Corpus();
+      // keep one frame for every factor frames of each bound, their
+      // FRAME_AVERAGE or FRAME_SUBSAMPLE; set before load
+      void set_frame_reduction(const int, const int);
+      // merge a bound into the one before when the cosine similarity of
+      // the frames either side of their edge is above the threshold
+      // (0 never merges); set before load
+      void set_merge_threshold(const float);
+      // mark the bounds that end at a landmark, a local minimum of the
+      // similarity of neighbouring frames: read from the Local_seg output
+      // <dir>/<basename>.lm when a directory is given, found over the
+      // loaded frames otherwise; set before load
+      void set_landmarks(const bool, const string&);
+      // read the (bounds file, data file) pairs of a list; labelled
+      // bounds files carry a cluster label after every bound, and every
+      // frame gets likelihood_dim zeroed likelihoods
+      bool load(const string&, const int, const bool, const int);
+      int get_utterance_num() const {return basenames.size();}
+      const string& get_basename(const int u) const {return basenames[u];}
+      // bounds of utterance u are [get_first_bound(u), get_first_bound(u + 1))
+      frame_index_t get_first_bound(const int u) const {return utt_first[u];}
+      frame_index_t get_bound_num() const {return starts.size();}
+      // frames of a bound, counted from the start of its utterance in
+      // the frames of the data files
+      int get_start(const frame_index_t b) const {return starts[b];}
+      int get_end(const frame_index_t b) const {return ends[b];}
+      // frames of a bound as loaded, after any reduction
+      int get_frame_count(const frame_index_t b) const \
+        {return frame_counts[b];}
+      // bounds of the bounds files, before any merging
+      frame_index_t get_candidate_num() const {return candidate_num;}
+      bool is_landmark(const frame_index_t b) const \
+        {return !landmarks.empty() && landmarks[b];}
+      int get_label(const frame_index_t b) const {return labels[b];}
+      frame_index_t get_frame_index(const frame_index_t b) const \
+        {return frame_index[b];}
+      frame_index_t get_frame_num() const {return frame_num;}
+      int get_dim() const {return dim;}
+      int get_likelihood_dim() const {return likelihood_dim;}
+      bool is_labelled() const {return labelled;}
+      const float* get_frame(const frame_index_t f) const \
+        {return frames.data() + (size_t) f * dim;}
+      const float* get_likelihoods(const frame_index_t f) const \
+        {return likelihoods.data() + (size_t) f * likelihood_dim;}
+      void clear();
+      ~Corpus();
+   private:
+      // reduce the frames of a bound, read into raw, onto the matrix
+      void reduce_frames(const float*, const int);
+      double edge_similarity(const frame_index_t) const;
+      bool read_landmarks();
+      void find_landmarks();
+      int dim;
+      int likelihood_dim;
+      bool labelled;
+      int frame_factor;
+      int frame_mode;
+      float merge_threshold;
+      frame_index_t candidate_num;
+      bool use_landmarks;
+      string landmark_dir;
+      frame_index_t frame_num;
+      vector<string> basenames;
+      vector<frame_index_t> utt_first;
+      // one entry per non-empty bound; frames within an utterance fit an
+      // int, so only the frame offset is wide
+      vector<int> starts;
+      vector<int> ends;
+      vector<int> labels;
+      vector<int> frame_counts;
+      vector<char> landmarks;
+      vector<frame_index_t> frame_index;
+      vector<float> frames;
+      vector<float> likelihoods;
+};
+
+#endif
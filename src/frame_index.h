@@ -0,0 +1,27 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./frame_index.h
+ *	FILE: frame_index.h                           *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef FRAME_INDEX_H
+#define FRAME_INDEX_H
+
+#include <stdint.h>
+
+// Index of a frame, bound or segment within the whole corpus. At 100
+// frames a second an int runs out after some 6,000 hours of audio.
+// Frame offsets within one utterance stay int.
+typedef int64_t frame_index_t;
+
+#define FRAME_INDEX_MAX INT64_MAX
+
+#endif
@@ -101,31 +101,28 @@ void Local_seg::self_align() {
 
 void Local_seg::output_local_min() {
    ofstream fout(outfile_name.c_str(), ios::out);
+   vector<char> minima;
+   find_local_min(align_scores, frame_num - 1, minima);
+   for(int i = 0; i < frame_num - 1 ; ++i) {
+      fout << (minima[i] ? '1' : '0') << endl;
+   }
+}
 
+// An edge is a landmark when its score is not above the one before and
+// below the next; the first edge only has to be below the next, and past
+// the last edge the scores are taken to rise.
+void Local_seg::find_local_min(const double* scores, const int len, \
+                               vector<char>& minima) {
    double thre = 0.0;
-   for(int i = 0; i < frame_num - 1 ; ++i) {
-      if (i == 0) {
-         if (align_scores[i] < align_scores[i+1] - thre) {
-            fout << '1' << endl;
-         }
-         else {
-            fout << '0' << endl;
-         }
-      }
-      else {
-         if (align_scores[i - 1] >= align_scores[i] && \
-             align_scores[i] < align_scores[i+1] ) {
-            if (abs(align_scores[i - 1] - align_scores[i]) > thre || \
-                abs(align_scores[i] - align_scores[i+1]) > thre) {
-               fout << '1' << endl;
-            }
-            else {
-               fout << '0' << endl;
-            }
-         }
-         else {
-            fout << '0' << endl;
-         }
+   minima.assign(len, 0);
+   if (len > 1) {
+      minima[0] = scores[0] < scores[1] - thre;
+   }
+   for (int i = 1; i < len; ++i) {
+      bool last = i == len - 1;
+      if (scores[i - 1] >= scores[i] && (last || scores[i] < scores[i + 1])) {
+         minima[i] = fabs(scores[i - 1] - scores[i]) > thre || last || \
+           fabs(scores[i] - scores[i + 1]) > thre;
       }
    }
 }
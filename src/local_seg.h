@@ -29,6 +29,8 @@ class Local_seg {
     ~Local_seg();
     void self_align();
     void output_local_min();
+    // mark the local minima of a run of scores of neighbouring frames
+    static void find_local_min(const double*, const int, vector<char>&);
  private:
     int frame_num;
     vector < vector<int> > non_zero_index;
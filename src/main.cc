@@ -23,10 +23,12 @@
 #include <time.h>
 
 #include "manager.h"
+#include "chain_runner.h"
 
 void print_usage() {
   cout << "Usage:" << endl;
-   cout << "  ./dnn-phone-learning -d [data-list] -c [config-file] -g [gibbs-iter] -r [results-dir] -b [batch_size] -s [snapshot]" << endl;
+   cout << "  ./dnn-phone-learning -d [data-list] -c [config-file] -g [gibbs-iter] -r [results-dir] -b [batch_size] -s [snapshot] -n [chains]" << endl;
+   cout << "  With -n above 1, -c may be given once per chain." << endl;
 }
 
 string replaceChar(string str, char ch1, char ch2) {
@@ -43,17 +45,20 @@ int main(int argc, char* argv[]) {
   string result_dir = "results_" + replaceChar(ctime(&timer), ' ', '_');
    string data_list = "";
    string config_file = "";
+   vector<string> chain_configs;
+   int chain_num = 1;
    int gibbs_iter = 100;
    int batch_size = 100;
    string snapshot = "";
 
    int c;
-   while ((c = getopt(argc, argv, "dcgrbs:")) != -1){
+   while ((c = getopt(argc, argv, "d:c:g:r:b:s:n:")) != -1){
      if(c == 'd'){
        data_list = optarg;
      }
      else if(c == 'c'){
        config_file = optarg;
+       chain_configs.push_back(optarg);
      }
      else if(c == 'g'){
        gibbs_iter = atoi(optarg);
@@ -67,12 +72,34 @@ int main(int argc, char* argv[]) {
      else if(c == 's'){
        snapshot = optarg;
      }
+     else if(c == 'n'){
+       chain_num = atoi(optarg);
+     }
      else{
        print_usage();
        return 1;
      }
    }
 
+   if (chain_num > 1) {
+      if (chain_configs.empty()) {
+         chain_configs.push_back(config_file);
+      }
+      ChainRunner runner;
+      if (!runner.init(chain_configs, chain_num)) {
+         return -1;
+      }
+      cout << "Sampler initialized successfully..." << endl;
+      if (!runner.load(data_list, snapshot, batch_size)) {
+         cout << "data list file seems bad. Check " 
+            << data_list << " to make sure." << endl;
+         return -1;
+      }
+      cout << "Data loaded successfully..." << endl;
+      runner.run(gibbs_iter, result_dir);
+      return 0;
+   }
+
    Manager projectManager;
    if (!projectManager.load_config(config_file)) {
       cout << "Configuration file seems bad. Check " 
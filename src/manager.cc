@@ -20,6 +20,9 @@
 #include <sstream>
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <sys/stat.h>
 
 #include "manager.h"
 #include "sampler.h"
@@ -29,6 +32,40 @@
 using namespace std;
 
 Manager::Manager() {
+   s_full_refresh = 100;
+   s_rng_pool_mb = 16;
+   s_seed = 0;
+   s_counter_rng = false;
+   s_threads = 1;
+   s_sync_interval = 1;
+   s_speculate = 0;
+   s_pipeline = false;
+   s_pipeline_point = 50;
+   s_group_frames = 0;
+   s_group_order = GROUP_ORDER_SEQUENTIAL;
+   s_adaptive_scan = false;
+   s_scan_stable = 5;
+   s_scan_floor = 0.1;
+   s_full_scan = 10;
+   s_converge_window = 0;
+   s_converge_tol = 1e-4;
+   s_blocked = false;
+   s_max_seg_bounds = 8;
+   s_semiring = SEMIRING_SUM;
+   s_frame_factor = 1;
+   s_frame_mode = FRAME_AVERAGE;
+   s_merge_threshold = 0.0;
+   s_landmark_h1 = 0.0;
+   s_plain_h1 = 0.1;
+   s_landmark_dir = "";
+   log_joint = 0.0;
+   converged = false;
+   pipeline_iter = 0;
+   pipeline_at = -1;
+   snapshot_bound = 0;
+   snapshot_total = 0;
+   cur_iter = 0;
+   sampler.set_context(&context);
 }
 
 std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems) {
@@ -58,6 +95,32 @@ bool Manager::load_config(const string& fnconfig) {
   s_gamma_weight_alpha = 3.0;
   s_gamma_trans_alpha = 3.0;
   s_h0 = 0.5;
+  s_full_refresh = 100;
+  s_rng_pool_mb = 16;
+  s_seed = 0;
+  s_counter_rng = false;
+  s_threads = 1;
+  s_sync_interval = 1;
+  s_speculate = 0;
+  s_pipeline = false;
+  s_pipeline_point = 50;
+  s_group_frames = 0;
+  s_group_order = GROUP_ORDER_SEQUENTIAL;
+  s_adaptive_scan = false;
+  s_scan_stable = 5;
+  s_scan_floor = 0.1;
+  s_full_scan = 10;
+  s_converge_window = 0;
+  s_converge_tol = 1e-4;
+  s_blocked = false;
+  s_max_seg_bounds = 8;
+  s_semiring = SEMIRING_SUM;
+  s_frame_factor = 1;
+  s_frame_mode = FRAME_AVERAGE;
+  s_merge_threshold = 0.0;
+  s_landmark_h1 = 0.0;
+  s_plain_h1 = 0.1;
+  s_landmark_dir = "";
 
    ifstream fconfig(fnconfig.c_str(), ifstream::in);
    string line;
@@ -96,10 +159,89 @@ bool Manager::load_config(const string& fnconfig) {
      else if(parts[0] == "s_h0"){
        s_h0 = std::strtof(value, &nullP);
      }
+     else if(parts[0] == "s_full_refresh"){
+       s_full_refresh = std::atoi(value);
+     }
+     else if(parts[0] == "s_rng_pool_mb"){
+       s_rng_pool_mb = std::atoi(value);
+     }
+     else if(parts[0] == "s_seed"){
+       s_seed = std::strtoul(value, &nullP, 10);
+     }
+     else if(parts[0] == "s_counter_rng"){
+       s_counter_rng = std::atoi(value);
+     }
+     else if(parts[0] == "s_threads"){
+       s_threads = std::atoi(value);
+     }
+     else if(parts[0] == "s_sync_interval"){
+       s_sync_interval = std::atoi(value);
+     }
+     else if(parts[0] == "s_speculate"){
+       s_speculate = std::atoi(value);
+     }
+     else if(parts[0] == "s_pipeline"){
+       s_pipeline = std::atoi(value);
+     }
+     else if(parts[0] == "s_pipeline_point"){
+       s_pipeline_point = std::atoi(value);
+     }
+     else if(parts[0] == "s_group_frames"){
+       s_group_frames = std::strtoll(value, &nullP, 10);
+     }
+     else if(parts[0] == "s_group_order"){
+       s_group_order = std::atoi(value);
+     }
+     else if(parts[0] == "s_adaptive_scan"){
+       s_adaptive_scan = std::atoi(value);
+     }
+     else if(parts[0] == "s_scan_stable"){
+       s_scan_stable = std::atoi(value);
+     }
+     else if(parts[0] == "s_scan_floor"){
+       s_scan_floor = std::strtof(value, &nullP);
+     }
+     else if(parts[0] == "s_full_scan"){
+       s_full_scan = std::atoi(value);
+     }
+     else if(parts[0] == "s_converge_window"){
+       s_converge_window = std::atoi(value);
+     }
+     else if(parts[0] == "s_converge_tol"){
+       s_converge_tol = std::strtof(value, &nullP);
+     }
+     else if(parts[0] == "s_blocked"){
+       s_blocked = std::atoi(value);
+     }
+     else if(parts[0] == "s_max_seg_bounds"){
+       s_max_seg_bounds = std::atoi(value);
+     }
+     else if(parts[0] == "s_semiring"){
+       s_semiring = std::atoi(value);
+     }
+     else if(parts[0] == "s_frame_factor"){
+       s_frame_factor = std::atoi(value);
+     }
+     else if(parts[0] == "s_frame_mode"){
+       s_frame_mode = std::atoi(value);
+     }
+     else if(parts[0] == "s_merge_threshold"){
+       s_merge_threshold = std::strtof(value, &nullP);
+     }
+     else if(parts[0] == "s_landmark_h1"){
+       s_landmark_h1 = std::strtof(value, &nullP);
+     }
+     else if(parts[0] == "s_plain_h1"){
+       s_plain_h1 = std::strtof(value, &nullP);
+     }
+     else if(parts[0] == "s_landmark_dir"){
+       s_landmark_dir = value;
+     }
      else{
        cout << "Unrecognized config parameter: " << parts[0] << endl;
      }
    }
+   context.semiring = s_semiring;
    return true;
 }
 
@@ -111,171 +253,132 @@ string Manager::get_basename(string s) {
      found_last_period - 1 - found_last_slash);
 }
 
+void Manager::prepare_corpus(Corpus& corpus) const {
+   corpus.set_frame_reduction(s_frame_factor, s_frame_mode);
+   corpus.set_merge_threshold(s_merge_threshold);
+   corpus.set_landmarks(s_landmark_h1 > 0, s_landmark_dir);
+}
+
 bool Manager::load_bounds(const string& fnbound_list, const int g_size) {
-   group_size = g_size;
+   prepare_corpus(own_corpus);
+   if (!own_corpus.load(fnbound_list, s_dim, false, context.cluster_counter)) {
+      return false;
+   }
+   return load_bounds(own_corpus, g_size);
+}
 
-   // open bounds list file
-   ifstream fbound_list(fnbound_list.c_str(), ifstream::in);
-   if (!fbound_list.is_open()) {
+Bound* Manager::make_bound(const Corpus& corpus, const frame_index_t b, \
+  const bool utt_end) {
+   int start = corpus.get_start(b);
+   int end = corpus.get_end(b);
+   frame_index_t frame = corpus.get_frame_index(b);
+   Bound* new_bound = new Bound(start, end, s_dim, utt_end, &context, \
+     corpus.get_frame(frame), corpus.get_likelihoods(frame), \
+     corpus.get_likelihood_dim(), corpus.get_frame_count(b));
+   new_bound -> set_index(context.bound_index_counter);
+   new_bound -> set_start_frame_index(context.total_frames);
+   ++context.bound_index_counter;
+   context.total_frames += corpus.get_frame_count(b);
+   return new_bound;
+}
+
+bool Manager::load_bounds(const Corpus& corpus, const int g_size) {
+   group_size = g_size;
+   if (corpus.get_dim() != s_dim) {
+      cout << "Corpus has " << corpus.get_dim() << " dimensions, s_dim is " \
+        << s_dim << endl;
       return false;
    }
-   cout << "file opened" << endl;
 
    int input_counter = 0;
-   string indexDir;
-   string dataDir; 
-   while (fbound_list.good()) {
-     string fn_index;
-     string fn_data;
-     fbound_list >> fn_index; // bounds file
-     fbound_list >> fn_data; // data file
+   for (int u = 0; u < corpus.get_utterance_num(); ++u) {
+     ++input_counter;
+     const string& basename = corpus.get_basename(u);
+     frame_index_t last = corpus.get_first_bound(u + 1);
+     vector<Bound*> a_seg;
+     for (frame_index_t b = corpus.get_first_bound(u); b < last; ++b) {
+       // create bound object over the corpus frames
+       Bound* new_bound = make_bound(corpus, b, b == last - 1);
 
-     if (fn_index != "" && fn_data != "") {
-         ++input_counter;
-         ifstream findex(fn_index.c_str(), ifstream::in);
-         ifstream fdata(fn_data.c_str(), ifstream::binary);
-         string basename = get_basename(fn_data);
+       // add to lists (housekeeping)
+       bounds.push_back(new_bound);
+       a_seg.push_back(new_bound);
 
-         if (!findex.is_open()) {
-            return false;
-         }
-         if (!fdata.is_open()) {
-            return false;
+       // sample whether this should be a boundary, from prior, or from
+       // one that favours landmarks
+       bool phn_end = s_landmark_h1 > 0 ? \
+         sampler.sample_boundary(new_bound, corpus.is_landmark(b) ? \
+           s_landmark_h1 : s_plain_h1) : \
+         sampler.sample_boundary(new_bound);
+       new_bound -> set_phn_end(phn_end);
+
+       // if this is a boundary
+       if (phn_end) {
+         // create a new segment from list of bounds since the last segment
+         Segment* new_segment = new Segment(basename, a_seg);
+         vector<Bound*>::iterator iter_members = a_seg.begin();
+         for(; iter_members != a_seg.end(); ++iter_members) {
+           (*iter_members) -> set_parent(new_segment);
          }
+         ++context.segment_counter;
+         segments.push_back(new_segment);
 
-         cout << "Loading " << fn_index << "..." << endl;
-         int total_frame_num;
-         findex >> total_frame_num;
-         cout << "total_frame_num: " << total_frame_num << endl;
+         // sample a cluster label for this segment
+         Cluster* new_c = sampler.sample_just_cluster(*new_segment, clusters);
+         // sample hidden states
+         sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
 
-         int start = 0;
-         int end = 0;
-         vector<Bound*> a_seg;
-         while (end != total_frame_num - 1) {
-	   // load one bound
-	   findex >> start;
-	   findex >> end;
-
-	   int frame_num = end - start + 1;
-	   float** frame_data = new float*[frame_num];
-
-	   // read data for this bound
-	   for (int i = 0; i < frame_num; ++i) {
-	     frame_data[i] = new float[s_dim];
-	     fdata.read(reinterpret_cast<char*>(frame_data[i]), sizeof(float) * s_dim);
-	   }
-	   
-	   // if this is the last frame of the utterance
-	   bool utt_end = false;
-	   if (end == total_frame_num - 1) {
-	     utt_end = true;
-	   }
-
-	   // create bound object
-	   Bound* new_bound = new Bound(start, end, s_dim, utt_end);
-	   new_bound -> set_index(Bound::index_counter);
-	   new_bound -> set_start_frame_index(Bound::total_frames);
-	   ++Bound::index_counter;
-	   Bound::total_frames += end - start + 1;
-
-	   // save data in object, then delete the temp arrays here
-	   new_bound -> set_data(frame_data);
-	   for(int i = 0; i < frame_num; ++i) {
-	     delete[] frame_data[i];
-	   }
-	   delete[] frame_data;
-
-	   // if the bound is not empty
-	   if (frame_num) {
-	     // add to lists (housekeeping)
-	     bounds.push_back(new_bound);
-	     a_seg.push_back(new_bound);
-
-	     // sample whether this should be a boundary, from prior
-	     bool phn_end = sampler.sample_boundary(new_bound);
-	     new_bound -> set_phn_end(phn_end);
-
-	     // if this is a boundary
-	     if (phn_end) {
-	       // create a new segment from list of bounds since the last segment
-	       Segment* new_segment = new Segment(basename, a_seg);
-	       vector<Bound*>::iterator iter_members = a_seg.begin();
-	       for(; iter_members != a_seg.end(); ++iter_members) {
-		 (*iter_members) -> set_parent(new_segment);
-	       }
-	       ++Segment::counter;
-	       segments.push_back(new_segment);
-
-	       // sample a cluster label for this segment
-	       Cluster* new_c = sampler.sample_just_cluster(*new_segment, clusters);
-	       // sample hidden states
-	       sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
-
-	       new_segment -> change_hash_status(false);
-	       cout << Segment::counter << " segments..." << endl;
-	       cout << Cluster::counter << " clusters..." << endl;
-
-	       //empty list of bounds
-	       a_seg.clear();
-	     }
-	   }
-	   else {
-	     // if bound is empty, delete it
-	     delete new_bound;
-	     Bound::index_counter--;
-	   }
-         }
+         new_segment -> change_hash_status(false);
+         cout << context.segment_counter << " segments..." << endl;
+         cout << context.cluster_counter << " clusters..." << endl;
 
-	 // we've finished reading the file - are there still bounds that we haven't added to a segment?
-         if (a_seg.size()) {
-	   Segment* new_segment = new Segment(basename, a_seg);
-	   vector<Bound*>::iterator iter_members = a_seg.begin();
-	   for(; iter_members != a_seg.end(); ++iter_members) {
-	     (*iter_members) -> set_parent(new_segment);
-	   }
-	   ++Segment::counter;
-	   segments.push_back(new_segment);
-
-	   // sample a cluster label for this segment
-	   Cluster* new_c = sampler.sample_just_cluster(*new_segment, clusters);
-	   // sample hidden states
-	   sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
-
-	   cout << Segment::counter << " segments..." << endl;
-	   cout << Cluster::counter << " clusters..." << endl;
-	   a_seg.clear();
-         }
+         //empty list of bounds
+         a_seg.clear();
+       }
+     }
 
-	 // get a pointer to the last bound added (i.e. the last bound in the file)
-         vector<Bound*>::iterator to_last = bounds.end();
-         to_last--;
-         (*to_last) -> set_utt_end(true);
-         (*to_last) -> set_phn_end(true);
+     // are there still bounds that we haven't added to a segment?
+     if (a_seg.size()) {
+       Segment* new_segment = new Segment(basename, a_seg);
+       vector<Bound*>::iterator iter_members = a_seg.begin();
+       for(; iter_members != a_seg.end(); ++iter_members) {
+         (*iter_members) -> set_parent(new_segment);
+       }
+       ++context.segment_counter;
+       segments.push_back(new_segment);
 
-	 // close files
-         findex.close();
-         fdata.close();
+       // sample a cluster label for this segment
+       Cluster* new_c = sampler.sample_just_cluster(*new_segment, clusters);
+       // sample hidden states
+       sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
+
+       cout << context.segment_counter << " segments..." << endl;
+       cout << context.cluster_counter << " clusters..." << endl;
+       a_seg.clear();
      }
+
+     // the last bound of the utterance
+     bounds.back() -> set_utt_end(true);
+     bounds.back() -> set_phn_end(true);
      cout << "input_counter: " << input_counter << endl;
-     
-     // is this just me, or does this make no sense? -- JD
-     if (!(input_counter % group_size) && fn_index != "" && fn_data != "") {
+
+     if (!(input_counter % group_size)) {
        cout << "push_back" << endl;
        batch_groups.push_back(bounds.size());
        cout << input_counter << " and " << bounds.size() << endl;
-      }
+     }
      if (!(input_counter % 100)) { 
        cout << "update_clusters" << endl;
-       update_clusters(false, 0);  // - JD 
+       update_clusters();  // - JD 
        cout << "update_clusters done" << endl;
-      }
+     }
    }
-   // what??? -- JD
    if (input_counter % group_size) {
       batch_groups.push_back(bounds.size());
       cout << input_counter << " and " << bounds.size() << endl;
    }
-   fbound_list.close();
+   form_groups();
+   index_utterances();
    load_data_to_matrix(); 
    return true;
 }
@@ -352,12 +455,12 @@ bool Manager::load_bounds_for_snapshot(const string& fnbound_list, const int g_s
             if (end == total_frame_num - 1) {
                utt_end = true;
             }
-            Bound* new_bound = new Bound(start, end, s_dim, utt_end);
+            Bound* new_bound = new Bound(start, end, s_dim, utt_end, &context);
             new_bound -> set_data(frame_data);
-            new_bound -> set_index(Bound::index_counter);
-            new_bound -> set_start_frame_index(Bound::total_frames);
-            ++Bound::index_counter;
-            Bound::total_frames += end - start + 1;
+            new_bound -> set_index(context.bound_index_counter);
+            new_bound -> set_start_frame_index(context.total_frames);
+            ++context.bound_index_counter;
+            context.total_frames += end - start + 1;
             for(int i = 0; i < frame_num; ++i) {
                delete[] frame_data[i];
             }
@@ -377,7 +480,7 @@ bool Manager::load_bounds_for_snapshot(const string& fnbound_list, const int g_s
                new_bound -> set_phn_end(phn_end);
                if (phn_end) {
                   Segment* new_segment = new Segment(basename, a_seg);
-                  ++Segment::counter;
+                  ++context.segment_counter;
                   segments.push_back(new_segment);
                   Cluster* new_c = sampler.\
                            sample_just_cluster(*new_segment, clusters);
@@ -387,21 +490,21 @@ bool Manager::load_bounds_for_snapshot(const string& fnbound_list, const int g_s
                      (*iter_members) -> set_parent(new_segment);
                   }
                   new_segment -> change_hash_status(false);
-                  cout << Segment::counter << " segments..." << endl;
-                  cout << Cluster::counter << " clusters..." << endl;
+                  cout << context.segment_counter << " segments..." << endl;
+                  cout << context.cluster_counter << " clusters..." << endl;
                   a_seg.clear();
                }
             }
             else {
                delete new_bound;
-               Bound::index_counter--;
+               context.bound_index_counter--;
             }
          }
 	 cout << "EOF" << endl;
          if (a_seg.size()) {
              cout << "Not cleaned" << endl;
              Segment* new_segment = new Segment(basename, a_seg);
-             ++Segment::counter;
+             ++context.segment_counter;
              segments.push_back(new_segment);
              Cluster* new_c = sampler.sample_just_cluster(*new_segment, clusters);
              sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
@@ -409,8 +512,8 @@ bool Manager::load_bounds_for_snapshot(const string& fnbound_list, const int g_s
              for(; iter_members != a_seg.end(); ++iter_members) {
                 (*iter_members) -> set_parent(new_segment);
              }
-             cout << Segment::counter << " segments..." << endl;
-             cout << Cluster::counter << " clusters..." << endl;
+             cout << context.segment_counter << " segments..." << endl;
+             cout << context.cluster_counter << " clusters..." << endl;
              a_seg.clear();
          }
          vector<Bound*>::iterator to_last = bounds.end();
@@ -430,7 +533,7 @@ bool Manager::load_bounds_for_snapshot(const string& fnbound_list, const int g_s
       }
       if (!(input_counter % 100)) {
 	cout << "update_clusters" << endl;
-         update_clusters(false, 0);   
+         update_clusters();   
 	cout << "update_clusters done" << endl;
       }
    }
@@ -439,14 +542,16 @@ bool Manager::load_bounds_for_snapshot(const string& fnbound_list, const int g_s
       cout << input_counter << " and " << bounds.size() << endl;
    }
    fbound_list.close();
+   form_groups();
+   index_utterances();
    load_data_to_matrix(); 
    return true;
 }
 
 void Manager::load_data_to_matrix() {
-   data = new const float*[Bound::total_frames];
+   data = new const float*[context.total_frames];
    list<Segment*>::iterator iter;
-   int ptr = 0;
+   frame_index_t ptr = 0;
    for(iter = segments.begin(); iter != segments.end(); ++iter) { 
       int frame_num = (*iter) -> get_frame_num();
       for (int i = 0; i < frame_num; ++i) {
@@ -455,6 +560,22 @@ void Manager::load_data_to_matrix() {
    }
 }
 
+void Manager::index_utterances() {
+   bound_utt.clear();
+   bound_state.clear();
+   int utt = 0;
+   vector<Bound*>::iterator iter_bounds = bounds.begin();
+   for (; iter_bounds != bounds.end(); ++iter_bounds) {
+      bound_utt.push_back(utt);
+      bound_state.push_back((*iter_bounds) -> get_phn_end());
+      if ((*iter_bounds) -> get_utt_end()) {
+         ++utt;
+      }
+   }
+   stable_visits.assign(utt, 0);
+   visit_utt.assign(utt, true);
+}
+
 /*
 bool Manager::load_segments(const string& fndata_list) {
    ifstream fdata_list(fndata_list.c_str(), ifstream::in);
@@ -493,11 +614,11 @@ bool Manager::load_segments(const string& fndata_list) {
                Segment* new_segment = new Segment(frame_num, s_dim, \
                  basename, start, end);
                new_segment -> set_frame_data(frame_data);
-               ++Segment::counter;
+               ++context.segment_counter;
                segments.push_back(new_segment);
                sampler.sample_cluster(*new_segment, clusters);
-               cout << Segment::counter << " segments..." << endl;
-               cout << Cluster::counter << " clusters..." << endl;
+               cout << context.segment_counter << " segments..." << endl;
+               cout << context.cluster_counter << " clusters..." << endl;
                for (int i = 0; i < frame_num; ++i) {
                   delete[] frame_data[i];
                }
@@ -514,7 +635,25 @@ bool Manager::load_segments(const string& fndata_list) {
    return true;
 }
 */
+void Manager::set_seed(const unsigned int seed) {
+   s_seed = seed;
+}
+
+void Manager::set_threads(const int threads) {
+   s_threads = threads;
+}
+
+void Manager::set_semiring(const int semiring) {
+   s_semiring = semiring;
+   context.semiring = semiring;
+}
+
 void Manager::init_sampler() {
+   sampler.set_seed(s_seed);
+   sampler.set_counter_rng(s_counter_rng);
+   pool.init(s_threads);
+   context.lane_num = pool.get_thread_num();
+   lane_streams.resize(pool.get_thread_num());
    sampler.init_prior(s_dim, \
      s_state, \
      s_dp_alpha, \
@@ -524,157 +663,888 @@ void Manager::init_sampler() {
      s_gamma_weight_alpha, \
      s_gamma_trans_alpha, \
      s_h0); 
+   sampler.set_pool_budget(s_rng_pool_mb);
+   // one sampler per lane for the boundary sweep, all on counter-based
+   // streams so utterances draw the same numbers on any lane; one
+   // thread gets one lane, which the pool runs inline
+   for (int l = 0; l < pool.get_thread_num(); ++l) {
+      Sampler* lane_sampler = new Sampler();
+      lane_sampler -> set_context(&context);
+      lane_sampler -> set_seed(sampler.get_seed());
+      lane_sampler -> set_counter_rng(true);
+      lane_sampler -> init_prior(s_dim, s_state, s_dp_alpha, \
+        s_beta_alpha, s_beta_beta, s_gamma_shape, s_norm_kappa, \
+        s_gamma_weight_alpha, s_gamma_trans_alpha, s_h0);
+      lane_samplers.push_back(lane_sampler);
+   }
+}
+
+void Manager::form_groups() {
+   if (s_group_frames > 0) {
+      batch_groups.clear();
+      frame_index_t frames = 0;
+      for (frame_index_t b = 0; b < (frame_index_t) bounds.size(); ++b) {
+         frames += bounds[b] -> get_frame_num();
+         if (bounds[b] -> get_utt_end() && frames >= s_group_frames) {
+            batch_groups.push_back(b + 1);
+            frames = 0;
+         }
+      }
+      if (frames > 0) {
+         batch_groups.push_back(bounds.size());
+      }
+   }
+   group_frames.assign(batch_groups.size(), 0);
+   group_seconds.assign(batch_groups.size(), 0.0);
+   group_order.clear();
+   group_log_joint.clear();
+   joint_trace.clear();
+   converged = false;
+   frame_index_t b = 0;
+   for (unsigned int g = 0; g < batch_groups.size(); ++g) {
+      for (; b < batch_groups[g]; ++b) {
+         group_frames[g] += bounds[b] -> get_frame_num();
+      }
+   }
+   if (!group_frames.empty()) {
+      cout << batch_groups.size() << " groups of " \
+        << *min_element(group_frames.begin(), group_frames.end()) << " to " \
+        << *max_element(group_frames.begin(), group_frames.end()) \
+        << " frames" << endl;
+   }
+}
+
+// Every epoch of batch_groups.size() iterations visits each group once.
+int Manager::next_group(const int i) {
+   int group_num = batch_groups.size();
+   if (!(i % group_num) || (int) group_order.size() != group_num) {
+      group_order.resize(group_num);
+      for (int g = 0; g < group_num; ++g) {
+         group_order[g] = g;
+      }
+      if (s_group_order == GROUP_ORDER_SHUFFLED) {
+         RngStream stream;
+         stream.set_key(sampler.get_seed(), i / group_num, 0, GROUP_STREAM);
+         for (int g = group_num - 1; g > 0; --g) {
+            int k = min(g, (int) (stream.sample_from_unit() * (g + 1)));
+            swap(group_order[g], group_order[k]);
+         }
+      }
+      else if (s_group_order == GROUP_ORDER_SIZE) {
+         // biggest first
+         for (int g = 1; g < group_num; ++g) {
+            for (int k = g; k > 0 && group_frames[group_order[k]] > \
+                 group_frames[group_order[k - 1]]; --k) {
+               swap(group_order[k], group_order[k - 1]);
+            }
+         }
+      }
+   }
+   return group_order[i % group_num];
+}
+
+void Manager::report_groups(const int epoch) {
+   int slowest = 0;
+   double total = 0.0;
+   for (unsigned int g = 0; g < group_seconds.size(); ++g) {
+      total += group_seconds[g];
+      if (group_seconds[g] > group_seconds[slowest]) {
+         slowest = g;
+      }
+   }
+   cout << "Epoch " << epoch << ": " << group_seconds.size() \
+        << " groups in " << total << " s, mean " \
+        << total / group_seconds.size() << " s, slowest group " << slowest \
+        << " (" << group_frames[slowest] << " frames) " \
+        << group_seconds[slowest] << " s" << endl;
+}
+
+// With adaptive scan, an utterance whose boundaries did not change over
+// its last s visits is visited with probability
+//
+//    max(s_scan_floor, 2^(-s / s_scan_stable)),
+//
+// a change puts it back to s = 0, and every s_full_scan-th epoch visits
+// all of them. A visit is an ordinary Gibbs update of the utterance, and
+// whether it happens depends only on the utterance's past visits, never
+// on the draws about to be made; the floor and the full sweeps keep every
+// utterance being updated, which adaptive random-scan Gibbs needs to stay
+// ergodic (Latuszynski, Roberts and Rosenthal, 2013).
+frame_index_t Manager::plan_scan(const frame_index_t first, \
+                                 const frame_index_t last) {
+   int epoch = cur_iter / batch_groups.size();
+   bool full = !s_adaptive_scan || \
+     (s_full_scan > 0 && !(epoch % s_full_scan));
+   RngStream stream;
+   frame_index_t visited = 0;
+   for (frame_index_t b = first; b < last; ++b) {
+      int utt = bound_utt[b];
+      if (b == first || bound_utt[b - 1] != utt) {
+         float p = pow(2.0, -(float) stable_visits[utt] / s_scan_stable);
+         stream.set_key(sampler.get_seed(), utt, cur_iter, SCAN_STREAM);
+         visit_utt[utt] = full || stream.sample_from_unit() < max(p, s_scan_floor);
+      }
+      visited += visit_utt[utt];
+   }
+   return visited;
+}
+
+frame_index_t Manager::skip_utterance(const frame_index_t b) {
+   frame_index_t end = b;
+   Segment* last_parent = NULL;
+   int segment_num = 0;
+   for (; end < (frame_index_t) bounds.size(); ++end) {
+      if (bounds[end] -> get_parent() != last_parent) {
+         last_parent = bounds[end] -> get_parent();
+         ++segment_num;
+      }
+      if (bounds[end] -> get_utt_end()) {
+         break;
+      }
+   }
+   list<Segment*>::iterator cut = segments.begin();
+   advance(cut, segment_num);
+   segments.splice(segments.end(), segments, segments.begin(), cut);
+   return end + 1;
+}
+
+frame_index_t Manager::record_scan(const frame_index_t first, \
+                                   const frame_index_t last) {
+   bool changed = false;
+   frame_index_t flips = 0;
+   for (frame_index_t b = first; b < last; ++b) {
+      int utt = bound_utt[b];
+      if (!visit_utt[utt]) {
+         continue;
+      }
+      if (bound_state[b] != bounds[b] -> get_phn_end()) {
+         changed = true;
+         ++flips;
+      }
+      bound_state[b] = bounds[b] -> get_phn_end();
+      if (bounds[b] -> get_utt_end()) {
+         stable_visits[utt] = changed ? 0 : stable_visits[utt] + 1;
+         changed = false;
+      }
+   }
+   return flips;
+}
+
+// The terms are the ones the boundary sampler scores: the cluster-marginal
+// log likelihood of every segment and the prior of every free bound.
+// Groups end at utterance ends, so no segment is split between two.
+double Manager::group_joint(const int g) {
+   frame_index_t first = g == 0 ? 0 : batch_groups[g - 1];
+   double joint = 0.0;
+   Segment* last_parent = NULL;
+   for (frame_index_t b = first; b < batch_groups[g]; ++b) {
+      Segment* parent = bounds[b] -> get_parent();
+      if (parent != last_parent) {
+         joint += parent -> get_hash();
+      }
+      last_parent = parent;
+      if (!bounds[b] -> get_utt_end()) {
+         joint += sampler.get_boundary_log_prior(bounds[b] -> get_phn_end());
+      }
+   }
+   return joint;
+}
+
+double Manager::cluster_entropy() const {
+   double total = 0.0;
+   for (unsigned int k = 0; k < clusters.size(); ++k) {
+      total += clusters[k] -> get_member_num();
+   }
+   double entropy = 0.0;
+   for (unsigned int k = 0; k < clusters.size() && total > 0; ++k) {
+      double p = clusters[k] -> get_member_num() / total;
+      if (p > 0) {
+         entropy -= p * log(p);
+      }
+   }
+   return entropy;
+}
+
+bool Manager::plateau() const {
+   if (s_converge_window <= 0) {
+      return false;
+   }
+   unsigned int window = max(s_converge_window, (int) batch_groups.size());
+   if (joint_trace.size() < 2 * window) {
+      return false;
+   }
+   double before = 0.0, last = 0.0;
+   unsigned int n = joint_trace.size();
+   for (unsigned int t = 0; t < window; ++t) {
+      before += joint_trace[n - 2 * window + t];
+      last += joint_trace[n - window + t];
+   }
+   before /= window;
+   last /= window;
+   // a window with an empty cluster or a failed score says nothing
+   if (!isfinite(before) || !isfinite(last)) {
+      return false;
+   }
+   return fabs(last - before) <= s_converge_tol * fabs(before);
 }
 
 bool Manager::update_boundaries(const int group_ptr) {
-   cout << "Total bounds is " << Bound::index_counter << endl;
-   cout << "Total segs is " << Segment::counter << endl;
-   //cout << "UB: number of clusters is " << Cluster::counter <<	
+   cout << "Total bounds is " << context.bound_index_counter << endl;
+   cout << "Total segs is " << context.segment_counter << endl;
+   //cout << "UB: number of clusters is " << context.cluster_counter <<	
    //     ", to double check " << clusters.size() << endl;
    vector<Bound*>::iterator iter_bounds = bounds.begin();
-   int i = group_ptr == 0 ? 0 : batch_groups[group_ptr - 1];
-   Sampler::offset = bounds[i] -> get_start_frame_index();
-   for (; i < batch_groups[group_ptr]; ++i) {
+   frame_index_t i = group_ptr == 0 ? 0 : batch_groups[group_ptr - 1];
+   frame_index_t first = i;
+   // the sweep takes segments off the front of the list and puts them
+   // back at the end, so after one group the next one is in front; a
+   // group visited out of order has the list turned to it first
+   Segment* first_parent = bounds[first] -> get_parent();
+   if (segments.front() != first_parent) {
+      list<Segment*>::iterator to_first = find(segments.begin(), \
+        segments.end(), first_parent);
+      segments.splice(segments.end(), segments, segments.begin(), to_first);
+   }
+   context.offset = bounds[i] -> get_start_frame_index();
+   chrono::steady_clock::time_point sweep_start = chrono::steady_clock::now();
+   frame_index_t bound_num = batch_groups[group_ptr] - first;
+   frame_index_t visited = plan_scan(first, batch_groups[group_ptr]);
+   pipeline_at = s_pipeline ? first + bound_num * s_pipeline_point / 100 : -1;
+   // with speculation on, the pool scores ahead within the utterance
+   // of the serial sweep instead of sampling utterances
+   bool speculate = s_speculate > 0 && pool.get_thread_num() > 1 && \
+     !s_blocked;
+   // the utterance sweep splices the group's segments off the front of
+   // the list, so they have to be there
+   bool swept = !speculate && \
+     segments.front() == bounds[first] -> get_parent();
+   frame_index_t speculated_end = first;
+   if (speculate) {
+      span_cache.clear();
+      span_cache.reset_counts();
+      sampler.set_span_cache(&span_cache);
+   }
+   if (swept && !sweep_utterances(first, batch_groups[group_ptr])) {
+      return false;
+   }
+   // the serial sweep draws from the same per-utterance streams as the
+   // lanes, whatever s_counter_rng says for the draws outside it
+   bool pooled_rng = !sampler.get_counter_rng();
+   sampler.set_counter_rng(true);
+   for (; !swept && i < batch_groups[group_ptr]; ++i) {
    //for(iter_bounds = bounds.begin(); iter_bounds != bounds.end(); 
    //  ++iter_bounds) {
-     cout << "UB: number of clusters is " << Cluster::counter <<	\
+     cout << "UB: number of clusters is " << context.cluster_counter <<	\
        ", to double check " << clusters.size() << endl;
+      if ((i == 0 || bounds[i - 1] -> get_utt_end()) && \
+          !visit_utt[bound_utt[i]]) {
+         i = skip_utterance(i) - 1;
+         continue;
+      }
+      // every utterance draws from its own (seed, utterance, iteration)
+      // stream, so its decisions do not depend on what ran before it
+      if (i == 0 || bounds[i - 1] -> get_utt_end()) {
+         sampler.set_stream_key(bound_utt[i], cur_iter);
+      }
+      if (pipeline_at >= 0 && i >= pipeline_at) {
+         start_pipeline(i - first, bound_num);
+      }
+      if (speculate && i >= speculated_end) {
+         speculated_end = speculate_spans(i);
+      }
+      if (s_blocked) {
+         if (!sampler.sample_utterance(iter_bounds + i, segments, clusters, \
+               s_max_seg_bounds)) {
+            cout << "Cannot update utterance " << bound_utt[i] << endl;
+            sampler.set_counter_rng(!pooled_rng);
+            return false;
+         }
+         while (!bounds[i] -> get_utt_end()) {
+            ++i;
+         }
+         continue;
+      }
 
       if (!sampler.sample_boundary(iter_bounds + i, segments, clusters)) {
          Segment* parent = (*iter_bounds) -> get_parent();
          cout << "Cannot update bound " << parent -> get_tag() 
               << "frame " << parent -> get_start_frame() << " to "
               << parent -> get_end_frame() << endl;
+         sampler.set_span_cache(NULL);
+         sampler.set_counter_rng(!pooled_rng);
          return false;
       }
    }
+   sampler.set_counter_rng(!pooled_rng);
+   if (speculate) {
+      sampler.set_span_cache(NULL);
+      cout << "Speculation: " << span_cache.get_hits() << " of " \
+           << span_cache.get_hits() + span_cache.get_misses() \
+           << " segment scores taken from the cache" << endl;
+   }
+   if (pipeline_at >= 0) {
+      start_pipeline(bound_num, bound_num);
+   }
+   frame_index_t flips = record_scan(first, batch_groups[group_ptr]);
+   // every group once, then just the one swept
+   if (group_log_joint.size() != batch_groups.size()) {
+      group_log_joint.resize(batch_groups.size());
+      for (unsigned int g = 0; g < batch_groups.size(); ++g) {
+         group_log_joint[g] = group_joint(g);
+      }
+   }
+   else {
+      group_log_joint[group_ptr] = group_joint(group_ptr);
+   }
+   log_joint = 0.0;
+   for (unsigned int g = 0; g < group_log_joint.size(); ++g) {
+      log_joint += group_log_joint[g];
+   }
+   cout << "Log joint " << log_joint << ", flip rate " \
+        << (visited ? (double) flips / visited : 0.0) \
+        << ", cluster entropy " << cluster_entropy() << endl;
+   if (s_adaptive_scan) {
+      cout << "Adaptive scan: visited " << visited << " of " << bound_num \
+           << " bounds" << endl;
+   }
+   double seconds = chrono::duration<double>(chrono::steady_clock::now() - \
+     sweep_start).count();
+   group_seconds[group_ptr] = seconds;
+   cout << "Swept group " << group_ptr << " (" << bound_num << " bounds, " \
+        << group_frames[group_ptr] << " frames) in " << seconds << " s (" \
+        << visited / seconds << " bounds/s on " \
+        << (swept || speculate ? pool.get_thread_num() : 1) << " threads)" << endl;
    return true;
 }
 
-void Manager::update_clusters(const bool to_precompute, const int group_ptr) {
-   vector<Cluster*>::iterator iter_clusters = clusters.begin();
+void Manager::start_pipeline(const frame_index_t done, \
+                             const frame_index_t total) {
+   pipeline_at = -1;
+   pipeline_iter = cur_iter + 1;
+   bool full_refresh = s_full_refresh > 0 && !(pipeline_iter % s_full_refresh);
+   // a draw that was never installed still owns the staged tables
+   if (pipeline_thread.joinable()) {
+      pipeline_thread.join();
+   }
+   staged.clear();
    for (unsigned int k = 0; k < clusters.size(); ++k) {
-     cout << "Cluster " << k << endl;
-      // clusters[k] -> show_member_len();
-      if (clusters[k] -> get_age() >= 500000000000 && \
-	  clusters[k] -> get_member_num() <= 100) {
-	cout << "old cluster" << endl;
-
-         int cluster_id = clusters[k] -> get_cluster_id();
-         int member_num = clusters[k] -> get_member_num(); 
-         delete clusters[k]; 
-         clusters.erase(iter_clusters + k);
-         --Cluster::counter;
-         Segment::counter -= member_num;
-         list<Segment*>::iterator iter_segments = segments.begin();
-         for (; iter_segments != segments.end(); ++iter_segments) {
-            if ((*iter_segments) -> get_cluster_id() == cluster_id) {
-	      ++Segment::counter;
-	      Cluster* new_c = sampler.sample_just_cluster(*(*iter_segments), clusters);
-	      sampler.sample_more_than_cluster(*(*iter_segments), clusters, new_c); 
-            }
+      if (full_refresh || clusters[k] -> is_dirty()) {
+         staged.resize(staged.size() + 1);
+         StagedDraw& draw = staged.back();
+         draw.id = clusters[k] -> get_cluster_id();
+         draw.generation = clusters.get_generation(draw.id);
+         draw.counts = clusters[k] -> get_cache_trans();
+         draw.table.resize(s_state * (s_state + 1));
+      }
+   }
+   snapshot_bound = done;
+   snapshot_total = total;
+   pipeline_thread = thread(&Manager::draw_staged, this);
+}
+
+// Runs on the pipeline thread; touches nothing but the staged draws and
+// the sampler's fixed priors.
+void Manager::draw_staged() {
+   RngStream stream;
+   for (unsigned int s = 0; s < staged.size(); ++s) {
+      stream.set_key(sampler.get_seed(), staged[s].id, pipeline_iter, \
+        CLUSTER_STREAM);
+      sampler.draw_trans(staged[s].counts, false, stream, &staged[s].table[0]);
+   }
+}
+
+// Scores spans in the span cache, one span per task.
+class SpanTask : public PoolTask {
+   public:
+      SpanTask(SpanCache& s_cache, const vector<int>& s_entries, \
+        const vector<frame_index_t>& s_firsts, \
+        const vector<frame_index_t>& s_lasts, \
+        vector<Bound*>& s_bounds, ClusterRegistry& s_clusters) : \
+        cache(s_cache), entries(s_entries), firsts(s_firsts), \
+        lasts(s_lasts), bounds(s_bounds), clusters(s_clusters) {}
+      void run(const int k, const int lane) {
+         vector<Bound*> members(bounds.begin() + firsts[k], \
+           bounds.begin() + lasts[k] + 1);
+         Segment span("", members);
+         double* scores = cache.get_scores(entries[k]);
+         for (unsigned int c = 0; c < clusters.size(); ++c) {
+            scores[c] = clusters[c] -> compute_likelihood(span);
          }
       }
-      else {
-	cout << "not old cluster" << endl;
-
-         sampler.sample_hmm_parameters(*clusters[k]);
-	cout << "params sampled" << endl;
-         clusters[k] -> update_age();
-	cout << "age updated" << endl;
-         if (to_precompute) {
-	   cout << "precompute" << endl;
-            vector<Bound*>::iterator iter_bounds = bounds.begin();
-            int i = group_ptr == 0 ? 0 : batch_groups[group_ptr - 1];
-	    cout << "group_ptr" << endl;
-            Bound* start_bound = *(iter_bounds + i);
-            Bound* end_bound = *(iter_bounds + batch_groups[group_ptr] - 1);
-            int start_index = start_bound -> get_start_frame_index();
-            int end_index = end_bound -> get_start_frame_index() + \
-                         end_bound -> get_frame_num();
-            const float* sec_data[end_index - start_index];
-	    cout << "indices" << endl;
-            for (int j = start_index; j < end_index; ++j) {
-               sec_data[j - start_index] = data[j];
-            }
-	    cout << "loop" << endl;
-            sampler.precompute(clusters[k], end_index - start_index, sec_data);
-	    cout << "precomputed" << endl;
+   private:
+      SpanCache& cache;
+      const vector<int>& entries;
+      const vector<frame_index_t>& firsts;
+      const vector<frame_index_t>& lasts;
+      vector<Bound*>& bounds;
+      ClusterRegistry& clusters;
+};
 
-            sampler.set_precompute_status(clusters[k], to_precompute);
+// Scores, on the pool, every segment that sampling bounds [b, b +
+// s_speculate) of the utterance will score if none of them changes the
+// segmentation. A changed decision only changes the spans of later
+// bounds, which then miss the cache and are scored as usual, so the
+// draws are the same as without speculation. Returns the first bound
+// past the window.
+frame_index_t Manager::speculate_spans(const frame_index_t b) {
+   span_cache.prune(b);
+   vector<frame_index_t> firsts;
+   vector<frame_index_t> lasts;
+   frame_index_t k = b;
+   for (; k < b + s_speculate; ++k) {
+      Segment* parent = bounds[k] -> get_parent();
+      frame_index_t p_first = parent -> get_first_bound_index();
+      frame_index_t p_last = parent -> get_last_bound_index();
+      // the same hypotheses as Sampler::sample_boundary; copies of
+      // hashed segments are not scored again
+      if (!bounds[k] -> get_phn_end()) {
+         if (!parent -> is_hashed()) {
+            firsts.push_back(p_first);
+            lasts.push_back(p_last);
+         }
+         firsts.push_back(p_first);
+         lasts.push_back(k);
+         firsts.push_back(k + 1);
+         lasts.push_back(p_last);
+      }
+      else if (!bounds[k] -> get_utt_end()) {
+         Segment* next_parent = bounds[k + 1] -> get_parent();
+         firsts.push_back(p_first);
+         lasts.push_back(next_parent -> get_last_bound_index());
+         if (!parent -> is_hashed()) {
+            firsts.push_back(p_first);
+            lasts.push_back(p_last);
+         }
+         if (!next_parent -> is_hashed()) {
+            firsts.push_back(next_parent -> get_first_bound_index());
+            lasts.push_back(next_parent -> get_last_bound_index());
          }
       }
+      else {
+         if (!parent -> is_hashed()) {
+            firsts.push_back(p_first);
+            lasts.push_back(p_last);
+         }
+         ++k;
+         break;
+      }
    }
+   vector<int> entries;
+   vector<frame_index_t> new_firsts;
+   vector<frame_index_t> new_lasts;
+   for (unsigned int s = 0; s < firsts.size(); ++s) {
+      if (!span_cache.contains(firsts[s], lasts[s])) {
+         entries.push_back(span_cache.insert(firsts[s], lasts[s], \
+           clusters.size()));
+         new_firsts.push_back(firsts[s]);
+         new_lasts.push_back(lasts[s]);
+      }
+   }
+   SpanTask task(span_cache, entries, new_firsts, new_lasts, bounds, clusters);
+   pool.parallel_for(entries.size(), task);
+   return k;
 }
 
-void Manager::gibbs_sampling(const int num_iter, const string result_dir) {
-   for (int i = 0; i <= num_iter; ++i) {
-      /*
-      if (i <= 10000) {
-         Sampler::annealing = 10 - (i / (num_iter / 10));
+// One utterance of a parallel sweep: its bounds, its segments spliced
+// out of the shared list, and the count changes sampling it made.
+struct UtteranceJob {
+   int utt;
+   frame_index_t first_bound;
+   frame_index_t end_bound;
+   list<Segment*> segments;
+   ClusterDelta delta;
+   bool ok;
+};
+
+// Longest utterances go first, so short ones fill in at the end.
+struct LongerJob {
+   LongerJob(const vector<UtteranceJob>& s_jobs) : jobs(s_jobs) {}
+   bool operator() (const int a, const int b) const {
+      frame_index_t len_a = jobs[a].end_bound - jobs[a].first_bound;
+      frame_index_t len_b = jobs[b].end_bound - jobs[b].first_bound;
+      return len_a != len_b ? len_a > len_b : a < b;
+   }
+   const vector<UtteranceJob>& jobs;
+};
+
+// Samples every bound of one utterance with the lane's own sampler,
+// on the utterance's own segment list and delta; blocked, all at once.
+// An exact task is alone in its wave, so it skips the delta and works
+// on the shared counts as the serial sweep does.
+class SweepTask : public PoolTask {
+   public:
+      SweepTask(vector<UtteranceJob>& s_jobs, const vector<int>& s_order, \
+        vector<Sampler*>& s_samplers, vector<Bound*>& s_bounds, \
+        ClusterRegistry& s_clusters, const unsigned int s_iter, \
+        const bool s_blocked, const int s_max_bounds, \
+        const bool s_exact) : \
+        jobs(s_jobs), order(s_order), samplers(s_samplers), \
+        bounds(s_bounds), clusters(s_clusters), iter(s_iter), \
+        blocked(s_blocked), max_bounds(s_max_bounds), exact(s_exact) {}
+      void run(const int k, const int lane) {
+         UtteranceJob& job = jobs[order[k]];
+         Sampler* lane_sampler = samplers[lane];
+         lane_sampler -> set_delta(exact ? NULL : &job.delta);
+         lane_sampler -> set_stream_key(job.utt, iter);
+         job.ok = true;
+         if (blocked) {
+            job.ok = lane_sampler -> sample_utterance(bounds.begin() + \
+              job.first_bound, job.segments, clusters, max_bounds);
+         }
+         for (frame_index_t i = job.first_bound; !blocked && \
+              i < job.end_bound; ++i) {
+            if (!lane_sampler -> sample_boundary(bounds.begin() + i, \
+                  job.segments, clusters)) {
+               job.ok = false;
+               break;
+            }
+         }
+         lane_sampler -> set_delta(NULL);
+         job.delta.publish(lane);
       }
-      else {
-         Sampler::annealing = 10.1;
-      }
-      */
-      Sampler::annealing = 10.1;
-      cout << "starting the " << i << " th iteration..." << endl;
-      cout << "Total number of clusters is " << Cluster::counter << \
-        ", to double check " << clusters.size() << endl;
-      cout << "Updating clusters..." << endl;
-      update_clusters(true, (i % batch_groups.size()));
-      cout << "New number of clusters is " << Cluster::counter << \
-        ", to double check " << clusters.size() << endl;
-      cout << "Updating boundaries..." << endl;
-      if (!update_boundaries(i % batch_groups.size())) {
-         cout << "Cannot update boundaries..." << endl;
-         return;
+   private:
+      vector<UtteranceJob>& jobs;
+      const vector<int>& order;
+      vector<Sampler*>& samplers;
+      vector<Bound*>& bounds;
+      ClusterRegistry& clusters;
+      unsigned int iter;
+      bool blocked;
+      int max_bounds;
+      bool exact;
+};
+
+// Utterances only meet through the cluster counts, so each one in a wave
+// is sampled against the counts as of the start of the wave plus its
+// own changes. Each task publishes its changes to its lane's shards, and
+// the shards are folded when the wave ends; the sums do not depend on
+// the order, so the results are the same for any s_threads.
+// With one utterance per wave there is nothing to merge: the utterance
+// is sampled straight into the shared counts, emptied clusters go at
+// once, and the draws are those of the serial sweep.
+bool Manager::sweep_utterances(const frame_index_t first, \
+                               const frame_index_t last) {
+   vector<UtteranceJob> jobs;
+   for (frame_index_t b = first; b < last;) {
+      jobs.resize(jobs.size() + 1);
+      UtteranceJob& job = jobs.back();
+      job.utt = bound_utt[b];
+      job.first_bound = b;
+      while (b < last - 1 && !bounds[b] -> get_utt_end()) {
+         ++b;
       }
-      if (!(i % 100) && i != 0) {
-         list<Segment*>::iterator iter_segments; 
-         for (iter_segments = segments.begin(); iter_segments != segments.end(); \
-               ++iter_segments) {
-            stringstream num_to_string;
-            num_to_string << i;
-            (*iter_segments) -> write_class_label(result_dir + "/" + num_to_string.str());
+      job.end_bound = ++b;
+      job.delta.set_state_num(s_state);
+   }
+   unsigned int wave = s_sync_interval > 0 ? s_sync_interval : jobs.size();
+   for (unsigned int w = 0; w < jobs.size(); w += wave) {
+      unsigned int w_end = min(w + wave, (unsigned int) jobs.size());
+      vector<int> order;
+      for (unsigned int j = w; j < w_end; ++j) {
+         // one segment per distinct parent among the utterance's bounds
+         int segment_num = 0;
+         Segment* last_parent = NULL;
+         for (frame_index_t b = jobs[j].first_bound; b < jobs[j].end_bound; ++b) {
+            if (bounds[b] -> get_parent() != last_parent) {
+               last_parent = bounds[b] -> get_parent();
+               ++segment_num;
+            }
+         }
+         list<Segment*>::iterator cut = segments.begin();
+         advance(cut, segment_num);
+         jobs[j].segments.splice(jobs[j].segments.begin(), segments, \
+           segments.begin(), cut);
+         // skipped utterances only go round the list
+         jobs[j].ok = true;
+         if (visit_utt[jobs[j].utt]) {
+            order.push_back(j);
          }
       }
-      if (!(i % 100) && i != 0) {
-         stringstream num_to_string;
-         num_to_string << i;
-         string fsnapshot = result_dir + "/" + \
-                            num_to_string.str() + "/snapshot";
-         cout << "Writing out to " << fsnapshot << " ..." << endl;
-         if (!state_snapshot(fsnapshot)) {
-            cout << "Cannot open " << fsnapshot << 
-              ". Please make sure the path exists" << endl; 
-            return;
+      sort(order.begin(), order.end(), LongerJob(jobs));
+      SweepTask task(jobs, order, lane_samplers, bounds, clusters, cur_iter, \
+        s_blocked, s_max_seg_bounds, wave == 1);
+      pool.parallel_for(order.size(), task);
+
+      bool ok = true;
+      // in utterance order, and in the order each utterance touched them
+      vector<Cluster*> touched;
+      for (unsigned int j = w; j < w_end; ++j) {
+         const vector<Cluster*>& models = jobs[j].delta.get_models();
+         touched.insert(touched.end(), models.begin(), models.end());
+         context.segment_counter += jobs[j].delta.get_segment_num();
+         jobs[j].delta.clear();
+         segments.splice(segments.end(), jobs[j].segments);
+         if (!jobs[j].ok) {
+            Segment* parent = bounds[jobs[j].first_bound] -> get_parent();
+            cout << "Cannot update utterance " << parent -> get_tag() << endl;
+            ok = false;
+         }
+      }
+      vector<Cluster*> folded(touched);
+      sort(folded.begin(), folded.end());
+      folded.erase(unique(folded.begin(), folded.end()), folded.end());
+      for (unsigned int c = 0; c < folded.size(); ++c) {
+         folded[c] -> fold_counts();
+      }
+      remove_empty_clusters(touched);
+      if (!ok) {
+         return false;
+      }
+      if (pipeline_at >= 0 && jobs[w_end - 1].end_bound >= pipeline_at) {
+         start_pipeline(jobs[w_end - 1].end_bound - first, last - first);
+      }
+   }
+   return true;
+}
+
+// Same as Sampler::clean_cluster, for the clusters a wave touched, in
+// the order the wave's utterances touched them.
+void Manager::remove_empty_clusters(vector<Cluster*>& touched) {
+   // ids first, a cluster can be listed again after it is gone
+   vector<int> ids;
+   for (unsigned int c = 0; c < touched.size(); ++c) {
+      ids.push_back(touched[c] -> get_cluster_id());
+   }
+   for (unsigned int c = 0; c < ids.size(); ++c) {
+      int id = ids[c];
+      Cluster* model = clusters.find(id);
+      if (model == NULL || model -> get_member_num() != 0) {
+         continue;
+      }
+      clusters.remove(id);
+      delete model;
+      --context.cluster_counter;
+   }
+}
+
+// Folds the published counts of every cluster, ages it and flags the
+// ones due for retirement. Each lane has its own list, so flagging takes
+// no lock; the serial step merges them.
+class AgeTask : public PoolTask {
+   public:
+      AgeTask(ClusterRegistry& s_clusters, vector<vector<int> >& s_retired) : \
+        clusters(s_clusters), retired(s_retired) {}
+      void run(const int k, const int lane) {
+         Cluster* model = clusters[k];
+         model -> fold_counts();
+         if (model -> get_age() >= 500000000000 && \
+             model -> get_member_num() <= 100) {
+            retired[lane].push_back(model -> get_cluster_id());
          }
-         vector<Cluster*>::iterator iter_clusters;
-         for (iter_clusters = clusters.begin(); iter_clusters != clusters.end(); \
-           ++iter_clusters) {
-            (*iter_clusters) -> state_snapshot(fsnapshot);
+         else {
+            model -> update_age();
          }
       }
-      /*
-      if (((num_iter - i <= 1000) && !(i % 100)) || i == 10 || (i % 500 == 0)) {
-         stringstream num_to_string;
-         num_to_string << i;
-         string fsnapshot = result_dir + "/" + \
-                            num_to_string.str() + "/snapshot";
-         cout << "Writing out to " << fsnapshot << " ..." << endl;
-         if (!state_snapshot(fsnapshot)) {
-            cout << "Cannot open " << fsnapshot << 
-              ". Please make sure the path exists" << endl; 
-            return;
+   private:
+      ClusterRegistry& clusters;
+      vector<vector<int> >& retired;
+};
+
+// Draws the transition table of each cluster from the stream of
+// (seed, cluster id, iteration), rekeying the lane's stream per cluster.
+class ResampleTask : public PoolTask {
+   public:
+      ResampleTask(const Sampler& s_sampler, vector<Cluster*>& s_models, \
+        vector<RngStream>& s_streams, const unsigned int s_iter) : \
+        sampler(s_sampler), models(s_models), streams(s_streams), \
+        iter(s_iter) {}
+      void run(const int k, const int lane) {
+         streams[lane].set_key(sampler.get_seed(), \
+           models[k] -> get_cluster_id(), iter, CLUSTER_STREAM);
+         sampler.sample_hmm_parameters(*models[k], streams[lane]);
+      }
+   private:
+      const Sampler& sampler;
+      vector<Cluster*>& models;
+      vector<RngStream>& streams;
+      unsigned int iter;
+};
+
+void Manager::update_clusters() {
+   // clusters whose counts have not moved since their last draw keep
+   // their transition tables, except on a periodic full refresh
+   bool full_refresh = s_full_refresh > 0 && !(cur_iter % s_full_refresh);
+   // the iteration barrier: the pipelined draw has to be done before
+   // anything changes the clusters
+   if (pipeline_thread.joinable()) {
+      pipeline_thread.join();
+   }
+
+   vector<vector<int> > retired(pool.get_thread_num());
+   AgeTask age_task(clusters, retired);
+   pool.parallel_for(clusters.size(), age_task);
+
+   // retire serially, in id order whichever lane flagged them, and hand
+   // the members back to the sampler
+   vector<int> retired_ids;
+   for (unsigned int l = 0; l < retired.size(); ++l) {
+      retired_ids.insert(retired_ids.end(), retired[l].begin(), \
+        retired[l].end());
+   }
+   sort(retired_ids.begin(), retired_ids.end());
+   for (unsigned int r = 0; r < retired_ids.size(); ++r) {
+      cout << "old cluster" << endl;
+      Cluster* old_cluster = clusters.find(retired_ids[r]);
+      int member_num = old_cluster -> get_member_num(); 
+      // collect the members before the cluster (and its list) goes away
+      vector<Segment*> orphans;
+      Segment* member = old_cluster -> get_first_member();
+      for (; member != NULL; member = member -> get_next_member()) {
+         orphans.push_back(member);
+      }
+      clusters.remove(retired_ids[r]);
+      delete old_cluster; 
+      --context.cluster_counter;
+      context.segment_counter -= member_num;
+      vector<Segment*>::iterator iter_orphans = orphans.begin();
+      for (; iter_orphans != orphans.end(); ++iter_orphans) {
+         ++context.segment_counter;
+         Cluster* new_c = sampler.sample_just_cluster(*(*iter_orphans), clusters);
+         sampler.sample_more_than_cluster(*(*iter_orphans), clusters, new_c); 
+      }
+   }
+
+   // swap in the tables drawn during the last sweep; clusters whose
+   // counts moved after the snapshot are still dirty and are drawn
+   // below, as are the ones the snapshot missed
+   if (!staged.empty() && pipeline_iter == cur_iter) {
+      int installed = 0;
+      int stale = 0;
+      for (unsigned int s = 0; s < staged.size(); ++s) {
+         Cluster* model = clusters.find(staged[s].id, staged[s].generation);
+         if (model == NULL) {
+            continue;
          }
-         for (iter_clusters = clusters.begin(); iter_clusters != clusters.end(); \
-           ++iter_clusters) {
-            (*iter_clusters) -> state_snapshot(fsnapshot);
+         if (model -> get_cache_trans() != staged[s].counts) {
+            ++stale;
          }
+         model -> set_trans(&staged[s].table[0], staged[s].counts);
+         ++installed;
+      }
+      cout << "Installed " << installed << " of " << clusters.size() \
+           << " cluster tables drawn " << snapshot_bound << " of " \
+           << snapshot_total << " bounds into the last sweep, " << stale \
+           << " from counts that have moved since" << endl;
+      // the snapshot already took the full refresh
+      full_refresh = false;
+   }
+   staged.clear();
+
+   // draw the transition tables of all dirty clusters
+   vector<Cluster*> to_sample;
+   for (unsigned int k = 0; k < clusters.size(); ++k) {
+      if (full_refresh || clusters[k] -> is_dirty()) {
+         to_sample.push_back(clusters[k]);
+      }
+   }
+   // per-cluster streams at every thread count, so one thread draws
+   // the same tables as many
+   ResampleTask resample_task(sampler, to_sample, lane_streams, cur_iter);
+   pool.parallel_for(to_sample.size(), resample_task);
+   cout << "Resampled " << to_sample.size() << " of " << clusters.size() \
+        << " clusters on " << pool.get_thread_num() << " threads" << endl;
+}
+
+void Manager::gibbs_sampling(const int num_iter, const string result_dir) {
+   for (int i = 0; i <= num_iter && !converged; ++i) {
+      if (!run_iteration(i, result_dir)) {
+         return;
+      }
+   }
+}
+
+bool Manager::write_results(const string& dir) {
+   mkdir(dir.c_str(), 0755);
+   list<Segment*>::iterator iter_segments; 
+   for (iter_segments = segments.begin(); iter_segments != segments.end(); \
+         ++iter_segments) {
+      (*iter_segments) -> write_class_label(dir);
+   }
+   string fsnapshot = dir + "/snapshot";
+   cout << "Writing out to " << fsnapshot << " ..." << endl;
+   if (!state_snapshot(fsnapshot)) {
+      cout << "Cannot open " << fsnapshot << 
+        ". Please make sure the path exists" << endl; 
+      return false;
+   }
+   vector<Cluster*>::iterator iter_clusters;
+   for (iter_clusters = clusters.begin(); iter_clusters != clusters.end(); \
+     ++iter_clusters) {
+      (*iter_clusters) -> state_snapshot(fsnapshot);
+   }
+   return true;
+}
+
+bool Manager::run_iteration(const int i, const string& result_dir) {
+   /*
+   if (i <= 10000) {
+      context.annealing = 10 - (i / (num_iter / 10));
+   }
+   else {
+      context.annealing = 10.1;
+   }
+   */
+   context.annealing = 10.1;
+   cur_iter = i;
+   cout << "starting the " << i << " th iteration..." << endl;
+   cout << "Total number of clusters is " << context.cluster_counter << \
+     ", to double check " << clusters.size() << endl;
+   cout << "Updating clusters..." << endl;
+   int group = next_group(i);
+   update_clusters();
+   cout << "New number of clusters is " << context.cluster_counter << \
+     ", to double check " << clusters.size() << endl;
+   cout << "Updating boundaries..." << endl;
+   if (!update_boundaries(group)) {
+      cout << "Cannot update boundaries..." << endl;
+      return false;
+   }
+   if (!((i + 1) % batch_groups.size())) {
+      report_groups(i / batch_groups.size());
+   }
+   joint_trace.push_back(log_joint);
+   if (!(i % 100) && i != 0) {
+      stringstream iter_dir;
+      iter_dir << result_dir << "/" << i;
+      if (!write_results(iter_dir.str())) {
+         return false;
       }
-      */
    }
+   if (!converged && plateau()) {
+      converged = true;
+      cout << "Log joint converged after iteration " << i << endl;
+      if (!write_results(result_dir + "/final")) {
+         return false;
+      }
+   }
+   /*
+   if (((num_iter - i <= 1000) && !(i % 100)) || i == 10 || (i % 500 == 0)) {
+      stringstream num_to_string;
+      num_to_string << i;
+      string fsnapshot = result_dir + "/" + \
+                         num_to_string.str() + "/snapshot";
+      cout << "Writing out to " << fsnapshot << " ..." << endl;
+      if (!state_snapshot(fsnapshot)) {
+         cout << "Cannot open " << fsnapshot << 
+           ". Please make sure the path exists" << endl; 
+         return false;
+      }
+      for (iter_clusters = clusters.begin(); iter_clusters != clusters.end(); \
+        ++iter_clusters) {
+         (*iter_clusters) -> state_snapshot(fsnapshot);
+      }
+   }
+   */
+   return true;
+}
+
+double Manager::get_log_marginal() const {
+   double log_marginal = 0.0;
+   list<Segment*>::const_iterator iter = segments.begin();
+   for (; iter != segments.end(); ++iter) {
+      log_marginal += (*iter) -> get_hash();
+   }
+   return log_marginal;
 }
 
 bool Manager::state_snapshot(const string& fn) {
@@ -682,16 +1552,18 @@ bool Manager::state_snapshot(const string& fn) {
    if (!fout.good()) {
       return false;
    }
-   int data_counter = Segment::counter;
-   fout.write(reinterpret_cast<char*> (&data_counter), sizeof(int));
-   int cluster_counter = Cluster::counter;
+   int mark = SNAPSHOT_MARK;
+   fout.write(reinterpret_cast<char*> (&mark), sizeof(int));
+   frame_index_t data_counter = context.segment_counter;
+   fout.write(reinterpret_cast<char*> (&data_counter), sizeof(frame_index_t));
+   int cluster_counter = context.cluster_counter;
    fout.write(reinterpret_cast<char*> (&cluster_counter), sizeof(int));
    /*
-   int aval_id = Cluster::aval_id;
+   int aval_id = context.aval_id;
    fout.write(reinterpret_cast<char*>(&aval_id), sizeof(int));
-   int cluster_counter = Cluster::counter;
+   int cluster_counter = context.cluster_counter;
    fout.write(reinterpret_cast<char*>(&cluster_counter), sizeof(int));
-   int aval_data = Segment::counter;
+   int aval_data = context.segment_counter;
    fout.write(reinterpret_cast<char*>(&aval_data), sizeof(int));
    int num_clusters = clusters.size();
    fout.write(reinterpret_cast<char*>(&num_clusters), sizeof(int));
@@ -703,14 +1575,26 @@ bool Manager::state_snapshot(const string& fn) {
 
 bool Manager::load_in_model(const string& fname, const int threshold) {
    ifstream fin(fname.c_str(), ios::binary);
-   int data_num;
+   frame_index_t data_num;
    int cluster_num;
    if (!fin.good()) {
       cout << fname << " cannot be opened." << endl;
       return false;
    }
-   fin.read(reinterpret_cast<char*> (&data_num), sizeof(int));
+   int first;
+   fin.read(reinterpret_cast<char*> (&first), sizeof(int));
+   if (first == SNAPSHOT_MARK) {
+      fin.read(reinterpret_cast<char*> (&data_num), sizeof(frame_index_t));
+   }
+   else {
+      data_num = first;
+   }
    fin.read(reinterpret_cast<char*> (&cluster_num), sizeof(int));
+   if (!fin.good() || data_num < 0 || cluster_num < 0) {
+      cout << fname << " does not start with valid segment and cluster " \
+        "counts." << endl;
+      return false;
+   }
    cout << "number of clusters " << cluster_num << endl;
    for (int i = 0; i < cluster_num; ++i) {
       int member_num;
@@ -719,7 +1603,12 @@ bool Manager::load_in_model(const string& fname, const int threshold) {
       fin.read(reinterpret_cast<char*> (&member_num), sizeof(int));
       fin.read(reinterpret_cast<char*> (&state_num), sizeof(int));
       fin.read(reinterpret_cast<char*> (&vector_dim), sizeof(int));
-      Cluster* new_cluster = new Cluster(state_num, vector_dim);
+      if (!fin.good() || member_num < 0 || state_num <= 0 || vector_dim <= 0) {
+         cout << fname << ": cluster " << i << " of " << cluster_num \
+           << " is truncated or corrupt." << endl;
+         return false;
+      }
+      Cluster* new_cluster = new Cluster(state_num, vector_dim, &context);
       new_cluster -> set_member_num(member_num);
       float trans[state_num * (state_num + 1)];
       fin.read(reinterpret_cast<char*> (trans), sizeof(float) * \
@@ -732,7 +1621,8 @@ bool Manager::load_in_model(const string& fname, const int threshold) {
 	//new_cluster -> set_weights(j,weights);
       }
       if (new_cluster -> get_member_num() > threshold) {
-         clusters.push_back(new_cluster);
+         new_cluster -> set_cluster_id();
+         clusters.insert(new_cluster);
       }
       else {
          data_num -= new_cluster -> get_member_num();
@@ -742,7 +1632,7 @@ bool Manager::load_in_model(const string& fname, const int threshold) {
    for (unsigned int i = 0; i < clusters.size(); ++i) {
       clusters[i] -> set_member_num(0);
    }
-   Cluster::counter = clusters.size();
+   context.cluster_counter = clusters.size();
    fin.close();
    return true;
 
@@ -750,123 +1640,60 @@ bool Manager::load_in_model(const string& fname, const int threshold) {
 
 
 Cluster* Manager::find_cluster(const int c_id) {
-   for (unsigned int i = 0; i < clusters.size(); ++i) {
-      if (clusters[i] -> get_cluster_id() == c_id) {
-         return clusters[i];
-      }
-   }
-   return NULL;
+   return clusters.find(c_id);
 }
 
 bool Manager::load_in_data(const string& fnbound_list, const int g_size) {
+   prepare_corpus(own_corpus);
+   if (!own_corpus.load(fnbound_list, s_dim, true, context.cluster_counter)) {
+      return false;
+   }
+   return load_in_data(own_corpus, g_size);
+}
+
+bool Manager::load_in_data(const Corpus& corpus, const int g_size) {
    group_size = g_size;
-   ifstream fbound_list(fnbound_list.c_str(), ifstream::in);
-   if (!fbound_list.is_open()) {
+   if (corpus.get_dim() != s_dim || !corpus.is_labelled()) {
+      cout << "Corpus does not match the configuration" << endl;
       return false;
    }
-   cout << "file opened" << endl;
    int input_counter = 0;
-   while (fbound_list.good()) {
-      string fn_index;
-      string fn_data;
-      fbound_list >> fn_index;
-      fbound_list >> fn_data;
-      if (fn_index != "" && fn_data != "") {
-         ++input_counter;
-         ifstream findex(fn_index.c_str(), ifstream::in);
-         ifstream fdata(fn_data.c_str(), ifstream::binary);
-         string basename = get_basename(fn_data);
-         vector<Bound*> a_seg;
-         if (!findex.is_open()) {
-            return false;
+   for (int u = 0; u < corpus.get_utterance_num(); ++u) {
+      ++input_counter;
+      const string& basename = corpus.get_basename(u);
+      frame_index_t last = corpus.get_first_bound(u + 1);
+      vector<Bound*> a_seg;
+      for (frame_index_t b = corpus.get_first_bound(u); b < last; ++b) {
+         bool utt_end = b == last - 1;
+         Bound* new_bound = make_bound(corpus, b, utt_end);
+         bounds.push_back(new_bound);
+         a_seg.push_back(new_bound);
+         // Sampler::sample_boundary(Bound*) is for sampling from prior
+         int cluster_label = corpus.get_label(b);
+         bool phn_end = false;
+         if (cluster_label != -1 || utt_end) {
+            phn_end = true;
          }
-         if (!fdata.is_open()) {
-            return false;
-         }
-         int start = 0;
-         int end = 0;
-         int cluster_label;
-         cout << "Loading " << fn_data << "..." << endl;
-         int total_frame_num;
-         findex >> total_frame_num;
-         while (end != total_frame_num - 1) {
-            findex >> start;
-            findex >> end;
-            findex >> cluster_label; 
-            int frame_num = end - start + 1;
-            float** frame_data = new float*[frame_num];
-            for (int i = 0; i < frame_num; ++i) {
-               frame_data[i] = new float[s_dim];
-               fdata.read(reinterpret_cast<char*>(frame_data[i]), \
-                    sizeof(float) * s_dim);
-            }
-            bool utt_end = false;
-            if (end == total_frame_num - 1) {
-               utt_end = true;
-            }
-            Bound* new_bound = new Bound(start, end, s_dim, utt_end);
-            new_bound -> set_data(frame_data);
-            new_bound -> set_index(Bound::index_counter);
-            new_bound -> set_start_frame_index(Bound::total_frames);
-            ++Bound::index_counter;
-            Bound::total_frames += end - start + 1;
-            for(int i = 0; i < frame_num; ++i) {
-               delete[] frame_data[i];
-            }
-            delete[] frame_data;
-            if (frame_num) {
-               bounds.push_back(new_bound);
-               a_seg.push_back(new_bound);
-               // Sampler::sample_boundary(Bound*) is for sampling from prior
-               bool phn_end = false;
-               if (cluster_label != -1 || utt_end) {
-                  phn_end = true;
-               }
-               new_bound -> set_phn_end(phn_end);
-               if (phn_end) {
-                  Segment* new_segment = new Segment(basename, a_seg);
-                  ++Segment::counter;
-                  segments.push_back(new_segment);
-                  Cluster* new_c = find_cluster(cluster_label);
-                  sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
-                  vector<Bound*>::iterator iter_members = a_seg.begin();
-                  for(; iter_members != a_seg.end(); ++iter_members) {
-                     (*iter_members) -> set_parent(new_segment);
-                  }
-                  new_segment -> change_hash_status(false);
-                  cout << Segment::counter << " segments..." << endl;
-                  cout << Cluster::counter << " clusters..." << endl;
-                  a_seg.clear();
-               }
-            }
-            else {
-               delete new_bound;
-               Bound::index_counter--;
+         new_bound -> set_phn_end(phn_end);
+         if (phn_end) {
+            Segment* new_segment = new Segment(basename, a_seg);
+            ++context.segment_counter;
+            segments.push_back(new_segment);
+            Cluster* new_c = find_cluster(cluster_label);
+            sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
+            vector<Bound*>::iterator iter_members = a_seg.begin();
+            for(; iter_members != a_seg.end(); ++iter_members) {
+               (*iter_members) -> set_parent(new_segment);
             }
+            new_segment -> change_hash_status(false);
+            cout << context.segment_counter << " segments..." << endl;
+            cout << context.cluster_counter << " clusters..." << endl;
+            a_seg.clear();
          }
-         if (a_seg.size()) {
-             cout << "Not cleaned" << endl;
-             Segment* new_segment = new Segment(basename, a_seg);
-             ++Segment::counter;
-             segments.push_back(new_segment);
-             Cluster* new_c = sampler.sample_just_cluster(*new_segment, clusters);
-             sampler.sample_more_than_cluster(*new_segment, clusters, new_c);
-             vector<Bound*>::iterator iter_members = a_seg.begin();
-             for(; iter_members != a_seg.end(); ++iter_members) {
-                (*iter_members) -> set_parent(new_segment);
-             }
-             cout << Segment::counter << " segments..." << endl;
-             cout << Cluster::counter << " clusters..." << endl;
-             a_seg.clear();
-         }
-         vector<Bound*>::iterator to_last = bounds.end();
-         to_last--;
-         (*to_last) -> set_utt_end(true);
-         (*to_last) -> set_phn_end(true);
-         findex.close();
-         fdata.close();
       }
-      if (!(input_counter % group_size) && fn_index != "" && fn_data != "") {
+      bounds.back() -> set_utt_end(true);
+      bounds.back() -> set_phn_end(true);
+      if (!(input_counter % group_size)) {
          batch_groups.push_back(bounds.size());
          cout << input_counter << " and " << bounds.size() << endl;
       }
@@ -875,7 +1702,8 @@ bool Manager::load_in_data(const string& fnbound_list, const int g_size) {
       batch_groups.push_back(bounds.size());
       cout << input_counter << " and " << bounds.size() << endl;
    }
-   fbound_list.close();
+   form_groups();
+   index_utterances();
    load_data_to_matrix(); 
    return true;
 
@@ -901,6 +1729,9 @@ bool Manager::load_snapshot(const string& fn_snapshot, const string& fn_data, \
 }
 
 Manager::~Manager() {
+   if (pipeline_thread.joinable()) {
+      pipeline_thread.join();
+   }
    delete[] data; 
    vector<Bound*>::iterator iter_bounds;
    iter_bounds = bounds.begin();
@@ -919,5 +1750,8 @@ Manager::~Manager() {
       delete *iter_clusters;
    }
    clusters.clear();
+   for (unsigned int l = 0; l < lane_samplers.size(); ++l) {
+      delete lane_samplers[l];
+   }
 }
 
@@ -19,38 +19,143 @@
 
 #include <cstring>
 #include <list>
+#include <thread>
 #include "sampler.h" 
 #include "cluster.h"
+#include "cluster_registry.h"
+#include "cluster_delta.h"
+#include "span_cache.h"
 #include "segment.h"
+#include "rng_stream.h"
+#include "thread_pool.h"
+#include "corpus.h"
+#include "run_context.h"
 
 using namespace std;
 
+// First int of snapshots written with a 64-bit segment count; older ones
+// start with the (int) segment count itself
+#define SNAPSHOT_MARK -2
+
+// orders in which an epoch visits the batch groups
+#define GROUP_ORDER_SEQUENTIAL 0
+#define GROUP_ORDER_SHUFFLED 1
+#define GROUP_ORDER_SIZE 2
+
+// Counts of one cluster as of the pipeline snapshot, and the table drawn
+// from them for the next iteration.
+struct StagedDraw {
+   int id;
+   unsigned int generation;
+   vector<vector<float> > counts;
+   vector<float> table;
+};
+
 class Manager {
    public:
       Manager();
       // bool load_segments(const string&);
       bool load_bounds(const string&, const int);
+      // segment a loaded corpus from the boundary prior; the bounds
+      // point into the corpus, which must outlive the manager
+      bool load_bounds(const Corpus&, const int);
       bool load_bounds_for_snapshot(const string&, const int);
+      // set up the configured load stages of a corpus, before its load
+      void prepare_corpus(Corpus&) const;
       bool load_config(const string&);
+      // override the configured seed, before init_sampler
+      void set_seed(const unsigned int);
+      // override the configured thread count, before init_sampler
+      void set_threads(const int);
+      // override the configured scoring semiring (SEMIRING_*)
+      void set_semiring(const int);
       void init_sampler();
       void gibbs_sampling(const int, const string);
+      bool run_iteration(const int, const string&);
+      // the seed in use once the sampler is initialized; before, the
+      // configured one (0 for the clock)
+      unsigned int get_seed() const \
+        {return sampler.get_seed() ? sampler.get_seed() : s_seed;}
+      frame_index_t get_segment_num() const {return segments.size();}
+      int get_cluster_num() const {return clusters.size();}
+      frame_index_t get_bound_num() const {return bounds.size();}
+      bool get_phn_end(const frame_index_t b) const \
+        {return bounds[b] -> get_phn_end();}
+      int get_dim() const {return s_dim;}
+      // the keys prepare_corpus hands to the corpus
+      int get_frame_factor() const {return s_frame_factor;}
+      int get_frame_mode() const {return s_frame_mode;}
+      float get_merge_threshold() const {return s_merge_threshold;}
+      bool get_landmarks() const {return s_landmark_h1 > 0;}
+      const string& get_landmark_dir() const {return s_landmark_dir;}
+      int get_threads() const {return s_threads;}
+      // sum of the cluster-marginal log likelihoods of all segments, as
+      // of each one's last cluster draw
+      double get_log_marginal() const;
+      // log joint of the boundaries and segments, every group as of its
+      // last sweep
+      double get_log_joint() const {return log_joint;}
+      // set once the log joint has plateaued; the run writes its final
+      // snapshot then
+      bool has_converged() const {return converged;}
+      // write the class labels and a snapshot into the given directory
+      bool write_results(const string&);
       // bool load_snapshot(const string&);
       bool update_boundaries(const int);
-      void update_clusters(const bool, const int);
+      // sample bounds [first, last) one utterance per task on the pool
+      bool sweep_utterances(const frame_index_t, const frame_index_t);
+      void remove_empty_clusters(vector<Cluster*>&);
+      frame_index_t speculate_spans(const frame_index_t);
+      // snapshot the counts after the given number of bounds out of the
+      // sweep's total and start drawing from them in the background
+      void start_pipeline(const frame_index_t, const frame_index_t);
+      void draw_staged();
+      void update_clusters();
       void load_data_to_matrix();
+      void index_utterances();
+      // recut the batch groups by frame count if so configured
+      void form_groups();
+      // group to sweep in the given iteration
+      int next_group(const int);
+      void report_groups(const int);
+      // choose the utterances of bounds [first, last) to visit, and
+      // count their bounds
+      frame_index_t plan_scan(const frame_index_t, const frame_index_t);
+      // move the segments of the utterance starting at the given bound
+      // to the back of the list unsampled; returns its end bound
+      frame_index_t skip_utterance(const frame_index_t);
+      // update the change history of the visited utterances; returns
+      // the number of bounds that flipped
+      frame_index_t record_scan(const frame_index_t, const frame_index_t);
       string get_basename(string);
       bool state_snapshot(const string&);
       bool load_snapshot(const string&, const string&, const int);
       bool load_in_model(const string&, const int);
       bool load_in_model_id(const string&);
       bool load_in_data(const string&, const int); 
+      bool load_in_data(const Corpus&, const int);
       Cluster* find_cluster(const int);
       ~Manager();
+      RunContext* get_context() {return &context;}
    private:
+      Bound* make_bound(const Corpus&, const frame_index_t, const bool);
+      // log joint of the bounds and segments of group g
+      double group_joint(const int);
+      // entropy of the cluster sizes, in nats
+      double cluster_entropy() const;
+      // whether the log joint has stopped moving over the last windows
+      bool plateau() const;
+      // the corpus of the file loaders; shared corpora live elsewhere
+      Corpus own_corpus;
+      // counters of this run; declared first, as everything else
+      // refers to it
+      RunContext context;
       Sampler sampler;
       list<Segment*> segments;
-      vector<Cluster*> clusters;
+      ClusterRegistry clusters;
       vector<Bound*> bounds;
+      // utterance number of every bound
+      vector<int> bound_utt;
       const float** data;
       int s_dim;
       int s_state;
@@ -63,7 +168,107 @@ class Manager {
       float s_gamma_trans_alpha;
       float s_h0;
       int group_size;
-      vector<int> batch_groups;
+      // resample every cluster, dirty or not, every s_full_refresh
+      // iterations (0 turns the refresh off)
+      int s_full_refresh;
+      // memory budget per random number pool, in MB
+      int s_rng_pool_mb;
+      // 0 seeds from the clock
+      unsigned int s_seed;
+      // draw the cluster labels at load and of retired clusters' members
+      // from counter streams too; boundary sweeps always do, from
+      // per-(utterance, iteration) streams
+      bool s_counter_rng;
+      // threads for the cluster update; every cluster draws from its
+      // own (seed, cluster, iteration) stream, so the drawn tables do
+      // not depend on the thread count
+      int s_threads;
+      ThreadPool pool;
+      vector<RngStream> lane_streams;
+      // utterances sampled between merges of their count changes in the
+      // boundary sweep; 1 (the default) samples each utterance straight
+      // into the counts, as a serial sweep does, and 0 merges once per
+      // group. The draws depend on this, not on s_threads.
+      int s_sync_interval;
+      vector<Sampler*> lane_samplers;
+      // bounds scored ahead of a serial sweep (0 turns speculation
+      // off); with s_threads above 1, takes the pool instead of the
+      // utterance sweep and draws as s_sync_interval 1 does
+      int s_speculate;
+      SpanCache span_cache;
+      // draw the next iteration's cluster parameters in the background,
+      // from counts taken s_pipeline_point percent into the sweep;
+      // clusters whose counts move after that are drawn again at the
+      // barrier
+      bool s_pipeline;
+      int s_pipeline_point;
+      thread pipeline_thread;
+      vector<StagedDraw> staged;
+      int pipeline_iter;
+      // bound at which the pending snapshot is due, -1 when none is
+      frame_index_t pipeline_at;
+      frame_index_t snapshot_bound;
+      frame_index_t snapshot_total;
+      int cur_iter;
+      // end bound of every group
+      vector<frame_index_t> batch_groups;
+      // cut groups at the first utterance end past this many frames
+      // instead of every group_size files (0)
+      frame_index_t s_group_frames;
+      // GROUP_ORDER_*; shuffles are drawn anew every epoch
+      int s_group_order;
+      vector<frame_index_t> group_frames;
+      vector<int> group_order;
+      // wall time of the last sweep of every group
+      vector<double> group_seconds;
+      // visit stable utterances with decreasing probability
+      bool s_adaptive_scan;
+      // unchanged visits that halve the visit probability
+      int s_scan_stable;
+      float s_scan_floor;
+      // every s_full_scan-th epoch visits everything (0 never does)
+      int s_full_scan;
+      // per utterance, visits since its boundaries last changed
+      vector<int> stable_visits;
+      vector<char> visit_utt;
+      // phn_end of every bound as of its utterance's last visit
+      vector<char> bound_state;
+      // per group, the cluster-marginal log likelihoods of its segments
+      // plus the boundary prior of its bounds, as of its last sweep; not
+      // kept up decision by decision, but rescanned from the swept
+      // group's bounds once the sweep is done
+      vector<double> group_log_joint;
+      double log_joint;
+      // log joint after every iteration
+      vector<double> joint_trace;
+      // stop once the mean log joint over the last s_converge_window
+      // iterations is within s_converge_tol of the window before, relative
+      // to it; windows are at least an epoch long, and 0 never stops
+      int s_converge_window;
+      float s_converge_tol;
+      bool converged;
+      // resample whole utterances by dynamic programming instead of one
+      // bound at a time, with segments of at most s_max_seg_bounds bounds
+      // (0 for any)
+      bool s_blocked;
+      int s_max_seg_bounds;
+      // SEMIRING_*: exact segment scores, or their Viterbi approximation
+      int s_semiring;
+      // load one frame per s_frame_factor frames of a bound, by
+      // FRAME_AVERAGE or FRAME_SUBSAMPLE; alignments stay in the frames
+      // of the data files
+      int s_frame_factor;
+      int s_frame_mode;
+      // merge bounds into the one before when the frames across their
+      // edge have a cosine similarity above this (0 keeps them all)
+      float s_merge_threshold;
+      // start from boundaries drawn with probability s_landmark_h1 at
+      // Local_seg landmarks and s_plain_h1 elsewhere, instead of from the
+      // flat prior (s_landmark_h1 0); landmarks are read from
+      // s_landmark_dir if set, found at load otherwise
+      float s_landmark_h1;
+      float s_plain_h1;
+      string s_landmark_dir;
 };
 
 #endif
@@ -0,0 +1,36 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./rng_backend.h
+ *	FILE: rng_backend.h                           *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef RNG_BACKEND_H
+#define RNG_BACKEND_H
+
+// Batched random number generation used by Sampler and Storage.
+// Exactly one implementation is linked in, chosen at build time with
+// RNG_BACKEND in the makefile: rng_mkl.cc wraps MKL VSL streams and
+// rng_portable.cc is a self-contained vectorized xoshiro generator.
+class RngBackend {
+   public:
+      virtual ~RngBackend() {};
+      // n uniforms on (a, b)
+      virtual void uniform(float*, const int, const float, const float) = 0;
+      // n gamma variates with the given shape and scale
+      virtual void gamma(float*, const int, const float, const float) = 0;
+      // n normal variates with the given mean and standard deviation
+      virtual void gaussian(float*, const int, const float, const float) = 0;
+      virtual const char* get_name() const = 0;
+      // new generator seeded with the given value
+      static RngBackend* create(const unsigned int);
+};
+
+#endif
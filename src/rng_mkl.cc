@@ -0,0 +1,49 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./rng_mkl.cc
+ *	FILE: rng_mkl.cc                              *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <mkl_vsl.h>
+#include "rng_backend.h"
+
+#define BRNG VSL_BRNG_MT19937 
+#define GAMMA_METHOD VSL_RNG_METHOD_GAMMA_GNORM
+#define UNIFORM_METHOD VSL_RNG_METHOD_UNIFORM_STD
+#define GAUSSIAN_METHOD VSL_RNG_METHOD_GAUSSIAN_ICDF 
+
+class MklRng : public RngBackend {
+   public:
+      MklRng(const unsigned int seed) {
+         vslNewStream(&stream, BRNG, seed);
+      }
+      void uniform(float* out, const int n, const float a, const float b) {
+         vsRngUniform(UNIFORM_METHOD, stream, n, out, a, b);
+      }
+      void gamma(float* out, const int n, const float shape, \
+                 const float scale) {
+         vsRngGamma(GAMMA_METHOD, stream, n, out, shape, 0, scale);
+      }
+      void gaussian(float* out, const int n, const float mean, \
+                    const float sd) {
+         vsRngGaussian(GAUSSIAN_METHOD, stream, n, out, mean, sd);
+      }
+      const char* get_name() const {return "mkl";}
+      ~MklRng() {
+         vslDeleteStream(&stream);
+      }
+   private:
+      VSLStreamStatePtr stream;
+};
+
+RngBackend* RngBackend::create(const unsigned int seed) {
+   return new MklRng(seed);
+}
@@ -0,0 +1,151 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./rng_portable.cc
+ *	FILE: rng_portable.cc                         *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <stdint.h>
+#include <cmath>
+#include "rng_backend.h"
+
+// number of independent xoshiro128+ generators stepped together; the
+// state is stored lane by lane so every step is a plain loop over the
+// lanes that the compiler turns into SIMD
+#define LANES 8
+// scratch size for the transforms
+#define CHUNK 256
+
+using namespace std;
+
+class PortableRng : public RngBackend {
+   public:
+      PortableRng(const unsigned int seed) {
+         // fill the lane states from splitmix64 of the seed
+         uint64_t x = seed;
+         for (int l = 0; l < LANES; ++l) {
+            for (int k = 0; k < 4; k += 2) {
+               x += 0x9E3779B97F4A7C15ULL;
+               uint64_t z = x;
+               z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+               z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+               z ^= z >> 31;
+               s[k][l] = (uint32_t) z;
+               s[k + 1][l] = (uint32_t) (z >> 32);
+            }
+         }
+         block_index = LANES;
+      }
+      void uniform(float* out, const int n, const float a, const float b) {
+         fill_unit(out, n);
+         float width = b - a;
+         for (int i = 0; i < n; ++i) {
+            out[i] = a + width * out[i];
+         }
+      }
+      void gaussian(float* out, const int n, const float mean, \
+                    const float sd) {
+         // Box-Muller on pairs of uniforms
+         float u1[CHUNK / 2];
+         float u2[CHUNK / 2];
+         for (int start = 0; start < n; start += CHUNK) {
+            int len = n - start < CHUNK ? n - start : CHUNK;
+            int pairs = (len + 1) / 2;
+            fill_unit(u1, pairs);
+            fill_unit(u2, pairs);
+            for (int i = 0; i < pairs; ++i) {
+               float r = sqrt(-2 * log(u1[i]));
+               float theta = 2 * M_PI * u2[i];
+               u1[i] = r * cos(theta);
+               u2[i] = r * sin(theta);
+            }
+            for (int i = 0; i < len; ++i) {
+               float z = (i & 1) ? u2[i / 2] : u1[i / 2];
+               out[start + i] = mean + sd * z;
+            }
+         }
+      }
+      void gamma(float* out, const int n, const float shape, \
+                 const float scale) {
+         // Marsaglia-Tsang; shapes below 1 are boosted by one and
+         // corrected with u^(1/shape)
+         float a = shape < 1 ? shape + 1 : shape;
+         float d = a - 1.0 / 3;
+         float c = 1 / sqrt(9 * d);
+         float x[CHUNK];
+         float u[CHUNK];
+         int filled = 0;
+         while (filled < n) {
+            // draw candidates for what is still missing, with an eighth
+            // extra since at least ~95% are accepted for shapes >= 1,
+            // then keep the accepted ones
+            int len = n - filled + (n - filled) / 8 + 2;
+            len = len < CHUNK ? len : CHUNK;
+            gaussian(x, len, 0, 1);
+            fill_unit(u, len);
+            for (int i = 0; i < len && filled < n; ++i) {
+               float v = 1 + c * x[i];
+               if (v <= 0) {
+                  continue;
+               }
+               v = v * v * v;
+               if (log(u[i]) < 0.5 * x[i] * x[i] + d - d * v + d * log(v)) {
+                  out[filled++] = d * v * scale;
+               }
+            }
+         }
+         if (shape < 1) {
+            float boost[CHUNK];
+            for (int start = 0; start < n; start += CHUNK) {
+               int len = n - start < CHUNK ? n - start : CHUNK;
+               fill_unit(boost, len);
+               for (int i = 0; i < len; ++i) {
+                  out[start + i] *= pow(boost[i], 1 / shape);
+               }
+            }
+         }
+      }
+      const char* get_name() const {return "portable";}
+      ~PortableRng() {};
+   private:
+      void next_block() {
+         for (int l = 0; l < LANES; ++l) {
+            block[l] = s[0][l] + s[3][l];
+            uint32_t t = s[1][l] << 9;
+            s[2][l] ^= s[0][l];
+            s[3][l] ^= s[1][l];
+            s[1][l] ^= s[2][l];
+            s[0][l] ^= s[3][l];
+            s[2][l] ^= t;
+            s[3][l] = (s[3][l] << 11) | (s[3][l] >> 21);
+         }
+         block_index = 0;
+      }
+      // uniforms on the open interval (0, 1) from the top 23 bits
+      void fill_unit(float* out, const int n) {
+         int i = 0;
+         while (i < n) {
+            if (block_index == LANES) {
+               next_block();
+            }
+            for (; block_index < LANES && i < n; ++block_index, ++i) {
+               out[i] = ((block[block_index] >> 9) + 0.5f) * \
+                        (1.0f / 8388608.0f);
+            }
+         }
+      }
+      uint32_t s[4][LANES];
+      uint32_t block[LANES];
+      int block_index;
+};
+
+RngBackend* RngBackend::create(const unsigned int seed) {
+   return new PortableRng(seed);
+}
@@ -0,0 +1,135 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./rng_stream.cc
+ *	FILE: rng_stream.cc                           *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <cmath>
+#include "rng_stream.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+RngStream::RngStream() {
+   set_key(0, 0, 0);
+}
+
+RngStream::RngStream(const unsigned int seed, \
+                     const unsigned int utterance, \
+                     const unsigned int iteration) {
+   set_key(seed, utterance, iteration);
+}
+
+// The key carries (seed, utterance); the iteration sits in the third
+// counter word and the lower two words count blocks within the stream.
+void RngStream::set_key(const unsigned int seed, \
+                        const unsigned int utterance, \
+                        const unsigned int iteration) {
+   set_key(seed, utterance, iteration, UTTERANCE_STREAM);
+}
+
+// The family goes into the last counter word.
+void RngStream::set_key(const unsigned int seed, \
+                        const unsigned int stream, \
+                        const unsigned int iteration, \
+                        const unsigned int family) {
+   key[0] = seed;
+   key[1] = stream;
+   counter[0] = 0;
+   counter[1] = 0;
+   counter[2] = iteration;
+   counter[3] = family;
+   block_index = 4;
+}
+
+void RngStream::philox(const uint32_t* ctr, const uint32_t* k, \
+                       uint32_t* out) {
+   uint32_t c[4] = {ctr[0], ctr[1], ctr[2], ctr[3]};
+   uint32_t k0 = k[0];
+   uint32_t k1 = k[1];
+   for (int r = 0; r < PHILOX_ROUNDS; ++r) {
+      uint64_t p0 = (uint64_t) PHILOX_M0 * c[0];
+      uint64_t p1 = (uint64_t) PHILOX_M1 * c[2];
+      uint32_t n0 = (uint32_t) (p1 >> 32) ^ c[1] ^ k0;
+      uint32_t n1 = (uint32_t) p1;
+      uint32_t n2 = (uint32_t) (p0 >> 32) ^ c[3] ^ k1;
+      uint32_t n3 = (uint32_t) p0;
+      c[0] = n0;
+      c[1] = n1;
+      c[2] = n2;
+      c[3] = n3;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+   }
+   for (int i = 0; i < 4; ++i) {
+      out[i] = c[i];
+   }
+}
+
+void RngStream::generate_block() {
+   philox(counter, key, block);
+   // advance the 64-bit block counter
+   if (++counter[0] == 0) {
+      ++counter[1];
+   }
+   block_index = 0;
+}
+
+float RngStream::sample_from_unit() {
+   if (block_index == 4) {
+      generate_block();
+   }
+   // top 23 bits, shifted by half a step so 0 and 1 never come out
+   uint32_t bits = block[block_index++] >> 9;
+   return (bits + 0.5f) * (1.0f / 8388608.0f);
+}
+
+void RngStream::fill_unit(float* out, const int n) {
+   for (int i = 0; i < n; ++i) {
+      out[i] = sample_from_unit();
+   }
+}
+
+float RngStream::sample_from_gaussian() {
+   // Box-Muller, one value per pair of uniforms
+   float u1 = sample_from_unit();
+   float u2 = sample_from_unit();
+   return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+float RngStream::sample_from_gamma(const float shape) {
+   // Marsaglia-Tsang; shapes below 1 are boosted by one and corrected
+   // with u^(1/shape), as in the portable backend
+   float a = shape < 1 ? shape + 1 : shape;
+   float d = a - 1.0 / 3;
+   float c = 1 / sqrt(9 * d);
+   float sample;
+   while (true) {
+      float x = sample_from_gaussian();
+      float v = 1 + c * x;
+      if (v <= 0) {
+         continue;
+      }
+      v = v * v * v;
+      float u = sample_from_unit();
+      if (log(u) < 0.5 * x * x + d - d * v + d * log(v)) {
+         sample = d * v;
+         break;
+      }
+   }
+   if (shape < 1) {
+      sample *= pow(sample_from_unit(), 1 / shape);
+   }
+   return sample;
+}
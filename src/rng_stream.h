@@ -0,0 +1,60 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./rng_stream.h
+ *	FILE: rng_stream.h                            *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef RNG_STREAM_H
+#define RNG_STREAM_H
+
+#include <stdint.h>
+
+// stream families, kept apart so that e.g. utterance 3 and cluster 3
+// never share draws within an iteration
+#define UTTERANCE_STREAM 0
+#define CLUSTER_STREAM 1
+#define GROUP_STREAM 2
+#define SCAN_STREAM 3
+
+// Counter-based random stream (Philox4x32-10).
+// A stream is fully determined by its key (seed, stream, iteration)
+// and the number of values drawn so far, so any number of threads can
+// each own a stream and reproduce the same draws no matter which thread
+// ends up doing the work. Streams hold no shared state.
+class RngStream {
+   public:
+      RngStream();
+      RngStream(const unsigned int, const unsigned int, const unsigned int);
+      // rewind the stream to the start of (seed, utterance, iteration)
+      void set_key(const unsigned int, const unsigned int, const unsigned int);
+      // same, for stream number n of the given family
+      void set_key(const unsigned int, const unsigned int, const unsigned int, \
+        const unsigned int);
+      // uniform on the open interval (0, 1)
+      float sample_from_unit();
+      void fill_unit(float*, const int);
+      // standard normal
+      float sample_from_gaussian();
+      // gamma with the given shape and unit scale
+      float sample_from_gamma(const float);
+      // one Philox4x32-10 block for the given counter and key, used by
+      // the known-answer check in rng_stream_check.cc
+      static void philox(const uint32_t*, const uint32_t*, uint32_t*);
+      ~RngStream() {};
+   private:
+      void generate_block();
+      uint32_t key[2];
+      uint32_t counter[4];
+      uint32_t block[4];
+      int block_index;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./rng_stream_check.cc
+ *	FILE: rng_stream_check.cc                     *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <iostream>
+#include <cstdio>
+#include "rng_stream.h"
+
+using namespace std;
+
+// Checks RngStream::philox against the Philox4x32-10 known-answer
+// vectors published with Random123, and that a stream keyed at
+// (0, 0, 0, 0) hands out the first of them. Run with "make check".
+int main() {
+   const uint32_t counters[3][4] = {
+      {0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u},
+      {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu},
+      {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}};
+   const uint32_t keys[3][2] = {
+      {0x00000000u, 0x00000000u},
+      {0xffffffffu, 0xffffffffu},
+      {0xa4093822u, 0x299f31d0u}};
+   const uint32_t expected[3][4] = {
+      {0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u},
+      {0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu},
+      {0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}};
+   int failed = 0;
+   for (int v = 0; v < 3; ++v) {
+      uint32_t out[4];
+      RngStream::philox(counters[v], keys[v], out);
+      for (int i = 0; i < 4; ++i) {
+         if (out[i] != expected[v][i]) {
+            printf("vector %d word %d: got %08x, expected %08x\n", \
+              v, i, out[i], expected[v][i]);
+            ++failed;
+         }
+      }
+   }
+   // the stream keeps the top 23 bits of each word
+   RngStream stream(0, 0, 0);
+   for (int i = 0; i < 4; ++i) {
+      float unit = stream.sample_from_unit();
+      uint32_t bits = (uint32_t) (unit * 8388608.0f - 0.5f);
+      if (bits != expected[0][i] >> 9) {
+         printf("stream word %d: got %06x, expected %06x\n", \
+           i, bits, expected[0][i] >> 9);
+         ++failed;
+      }
+   }
+   if (failed) {
+      cout << failed << " known-answer mismatches" << endl;
+      return 1;
+   }
+   cout << "Philox4x32-10 known-answer check passed" << endl;
+   return 0;
+}
@@ -0,0 +1,54 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./run_context.h
+ *	FILE: run_context.h                           *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef RUN_CONTEXT_H
+#define RUN_CONTEXT_H
+
+#include "frame_index.h"
+#include "semiring.h"
+
+// Counters of one sampling run. The manager of a run owns its context
+// and hands it to the sampler and to every bound, segment and cluster it
+// makes, so any number of runs can live and sample side by side in one
+// process.
+struct RunContext {
+   // bounds loaded, and frames in them
+   frame_index_t bound_index_counter;
+   frame_index_t total_frames;
+   // segments and clusters in the model
+   frame_index_t segment_counter;
+   int cluster_counter;
+   // next free cluster id
+   int aval_id;
+   // first frame of the bound being sampled
+   frame_index_t offset;
+   float annealing;
+   // lanes that can publish counts; set before clusters are made
+   int lane_num;
+   // SEMIRING_*, for every segment score of the run
+   int semiring;
+   RunContext() {
+      bound_index_counter = 0;
+      total_frames = 0;
+      segment_counter = 0;
+      cluster_counter = 0;
+      aval_id = 0;
+      offset = 0;
+      annealing = 10.1;
+      lane_num = 1;
+      semiring = SEMIRING_SUM;
+   }
+};
+
+#endif
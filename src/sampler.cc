@@ -18,7 +18,7 @@
 #include <cstring>
 #include <ctime>                        // define time()
 #include <cmath>
-#include <mkl_vml.h>
+#include <algorithm>
 
 /*
 #include "boost/math/distributions/beta.hpp"  // distributions from boost
@@ -32,21 +32,22 @@
 #include "segment.h"
 #include "cluster.h"
 
-#define BRNG VSL_BRNG_MT19937 
-#define GAMMA_METHOD VSL_RNG_METHOD_GAMMA_GNORM
-#define UNIFORM_METHOD VSL_RNG_METHOD_UNIFORM_STD
-#define GAUSSIAN_METHOD VSL_RNG_METHOD_GAUSSIAN_ICDF 
 #define SKIP true 
+// categorical tables up to this size are searched linearly
+#define LINEAR_SEARCH_MAX 16
 
 using namespace std;
 
 // using namespace boost::math;
 // using namespace boost::random;
 
-float Sampler::annealing = 10.1;
-int Sampler::offset = 0;
-
 Sampler::Sampler() {
+   context = NULL;
+   seed = 0;
+   use_counter_rng = false;
+   delta = NULL;
+   span_cache = NULL;
+   rng = NULL;
    UNIT = 0;
    MEAN = 1;
    PRE = 2;
@@ -63,37 +64,48 @@ bool Sampler::sample_boundary(Bound* bound) {
    return false;
 }
 
-bool Sampler::decluster(Segment* ptr, vector<Cluster*>& clusters) {
-   vector<Cluster*>::iterator iter_clusters;
-   for(iter_clusters = clusters.begin(); \
-     iter_clusters != clusters.end(); ++iter_clusters) {
-      if (ptr -> get_cluster_id() == (*iter_clusters) -> get_cluster_id()){
-         (*iter_clusters) -> remove_members(ptr);
-         return true;
-      }
+bool Sampler::sample_boundary(Bound* bound, const float h1) {
+   if (bound -> get_utt_end()) {
+      return true;
+   }
+   double prior[2] = {1 - h1, h1};
+   if (sample_index_from_distribution(prior, 2)) {
+      return true;
    }
    return false;
 }
 
-bool Sampler::clean_cluster(Segment* ptr, vector<Cluster*>& clusters) {
-   vector<Cluster*>::iterator iter_clusters;
-   for(iter_clusters = clusters.begin(); \
-     iter_clusters != clusters.end(); ++iter_clusters) {
-      if (ptr -> get_cluster_id() == (*iter_clusters) -> get_cluster_id()){
-         if ((*iter_clusters)->get_member_num()== 0) {
-            delete *iter_clusters;
-            clusters.erase(iter_clusters);
-            Cluster::counter--;
-         }
-         return true;
+bool Sampler::decluster(Segment* ptr, ClusterRegistry& clusters) {
+   Cluster* model = clusters.find(ptr -> get_cluster_id());
+   if (model == NULL) {
+      return false;
+   }
+   drop_member(ptr, model);
+   return true;
+}
+
+bool Sampler::clean_cluster(Segment* ptr, ClusterRegistry& clusters) {
+   Cluster* model = clusters.find(ptr -> get_cluster_id());
+   if (model == NULL) {
+      return false;
+   }
+   // with a delta the registry is shared with other threads; empty
+   // clusters are removed once the deltas are merged
+   if (delta == NULL && model -> get_member_num() == 0) {
+      clusters.remove(model -> get_cluster_id());
+      delete model;
+      context -> cluster_counter--;
+      // emission scores are indexed by the cluster count
+      if (span_cache != NULL) {
+         span_cache -> clear();
       }
    }
-   return false;
+   return true;
 }
 
 bool Sampler::sample_boundary(vector<Bound*>::iterator iter, \
                               list<Segment*>& segments, \
-                              vector<Cluster*>& clusters) {
+                              ClusterRegistry& clusters) {
   // if there is not currently a boundary here
   if (!(*iter) -> get_phn_end()) {
 
@@ -130,7 +142,7 @@ bool Sampler::sample_boundary(vector<Bound*>::iterator iter, \
     }
 
     segments.pop_front();
-    Segment::counter--;
+    change_segment_num(-1);
     delete parent;
 
     // sample whether there should be a boundary here
@@ -176,7 +188,7 @@ bool Sampler::sample_boundary(vector<Bound*>::iterator iter, \
       segments.pop_front();
       delete parent;
       delete next_parent;
-      Segment::counter -= 2;
+      change_segment_num(-2);
 
       // sample new boundary info
       SampleBoundInfo info = sample_h0_h1(h0, h1_l, h1_r, clusters);
@@ -199,41 +211,182 @@ bool Sampler::sample_boundary(vector<Bound*>::iterator iter, \
       }
       segments.pop_front();
       delete parent;
-      --Segment::counter;
+      change_segment_num(-1);
 
       // resample
       Cluster* new_c;
       if (new_segment -> is_hashed()) {
-	cout << "hashed" << endl;
-	for(unsigned int i = 0; i < clusters.size(); ++i) {
-	  if (new_segment -> get_cluster_id() == clusters[i] -> get_cluster_id()) {
-	    new_c = clusters[i];
-	  }
-	  encluster(*new_segment, clusters, new_c);
-	}
-	else {
-	  cout << "cleaning" << endl;
+	new_c = clusters.find(new_segment -> get_cluster_id());
+	encluster(*new_segment, clusters, new_c);
+      }
+      else {
 	  if (!clean_cluster(new_segment, clusters)) {
 	    cout << "Cannot clean clusters..." << endl;
 	    return false;
 	  }
 	  new_c = sample_just_cluster(*new_segment, clusters);
 	  sample_more_than_cluster(*new_segment, clusters, new_c);
-	}
-	
-	new_segment -> change_hash_status(false);
-	segments.push_back(new_segment);
-	++Segment::counter;
       }
+	
+      new_segment -> change_hash_status(false);
+      segments.push_back(new_segment);
+      change_segment_num(1);
     }
   }
   return true;
 }
 
+// Forward filtering, backward sampling over the bounds of one utterance.
+// Every candidate segment is scored under every cluster, with the counts
+// as they stand once the utterance's own segments are taken out:
+//
+//    forward[k] = log P(bounds before k, a phone ending just before k)
+//               = logsum_l forward[k - l] + score(k - l, l)
+//                 + (l - 1) log h0 + log h1,
+//
+// where score(j, l) combines over the clusters, in the semiring of the
+// run, the prior of the cluster and the likelihood of the segment of
+// bounds [j, j + l) under it, and the last segment ends the utterance
+// instead of drawing log h1. The segments are drawn from the end back,
+// then their clusters from the same scores, and the segments go to the
+// back of the list in order.
+bool Sampler::sample_utterance(vector<Bound*>::iterator first, \
+                               list<Segment*>& segments, \
+                               ClusterRegistry& clusters, \
+                               const int max_bounds) {
+   vector<Bound*> utt_bounds;
+   for (vector<Bound*>::iterator iter = first; ; ++iter) {
+      utt_bounds.push_back(*iter);
+      if ((*iter) -> get_utt_end()) {
+         break;
+      }
+   }
+   int bound_num = utt_bounds.size();
+   int cluster_num = clusters.size();
+   if (cluster_num == 0) {
+      cout << "No clusters to segment with..." << endl;
+      return false;
+   }
+   string tag = (*first) -> get_parent() -> get_tag();
+
+   // take the utterance's segments out of the list and the counts
+   vector<Segment*> old_segments;
+   for (int k = 0; k < bound_num; ++k) {
+      Segment* parent = utt_bounds[k] -> get_parent();
+      if (!old_segments.empty() && old_segments.back() == parent) {
+         continue;
+      }
+      if (!decluster(parent, clusters)) {
+         cout << "Cannot remove segment..." << endl;
+         return false;
+      }
+      segments.pop_front();
+      change_segment_num(-1);
+      old_segments.push_back(parent);
+   }
+
+   vector<const float*> frames;
+   vector<int> frame_start(bound_num + 1, 0);
+   for (int k = 0; k < bound_num; ++k) {
+      for (int i = 0; i < utt_bounds[k] -> get_frame_num(); ++i) {
+         frames.push_back(utt_bounds[k] -> get_frame_i_likelihoods(i));
+      }
+      frame_start[k + 1] = frames.size();
+   }
+
+   // posts[(j * span + l - 1) * cluster_num + c]: log prior and
+   // likelihood of the segment of bounds [j, j + l) under cluster c
+   int span = max_bounds > 0 ? min(max_bounds, bound_num) : bound_num;
+   vector<double> posts((size_t) bound_num * span * cluster_num);
+   vector<double> scores((size_t) bound_num * span);
+   vector<double> priors(cluster_num);
+   for (int c = 0; c < cluster_num; ++c) {
+      priors[c] = get_non_dp_prior(clusters[c]);
+   }
+   int ends[span];
+   double likelihoods[span];
+   double weights[max(span, cluster_num)];
+   for (int j = 0; j < bound_num; ++j) {
+      int len = min(span, bound_num - j);
+      for (int l = 0; l < len; ++l) {
+         ends[l] = frame_start[j + l + 1] - frame_start[j];
+      }
+      double* post = &posts[(size_t) j * span * cluster_num];
+      for (int c = 0; c < cluster_num; ++c) {
+         clusters[c] -> compute_span_likelihoods(&frames[frame_start[j]], \
+           len, ends, likelihoods);
+         for (int l = 0; l < len; ++l) {
+            post[l * cluster_num + c] = priors[c] + likelihoods[l];
+         }
+      }
+      for (int l = 0; l < len; ++l) {
+         memcpy(weights, post + l * cluster_num, sizeof(double) * cluster_num);
+         scores[(size_t) j * span + l] = combine_scores(weights, cluster_num);
+      }
+   }
+
+   vector<double> forward(bound_num + 1, 0.0);
+   for (int k = 1; k <= bound_num; ++k) {
+      int len = min(span, k);
+      for (int l = 1; l <= len; ++l) {
+         weights[l - 1] = forward[k - l] + scores[(size_t) (k - l) * span + l - 1] \
+           + (l - 1) * boundary_prior_log[0];
+      }
+      forward[k] = calculator.sum_logs(weights, len) + \
+        (k < bound_num ? boundary_prior_log[1] : 0.0);
+   }
+
+   vector<int> cuts;
+   for (int k = bound_num; k > 0; ) {
+      int len = min(span, k);
+      for (int l = 1; l <= len; ++l) {
+         weights[l - 1] = forward[k - l] + scores[(size_t) (k - l) * span + l - 1] \
+           + (l - 1) * boundary_prior_log[0];
+      }
+      k -= sample_index_from_log_distribution(weights, len, NULL) + 1;
+      cuts.push_back(k);
+   }
+
+   int start = 0;
+   for (int n = cuts.size() - 1; n >= 0; --n) {
+      int end = n > 0 ? cuts[n - 1] : bound_num;
+      vector<Bound*> members(utt_bounds.begin() + start, \
+        utt_bounds.begin() + end);
+      Segment* new_segment = new Segment(tag, members);
+      for (int k = start; k < end; ++k) {
+         utt_bounds[k] -> set_parent(new_segment);
+         utt_bounds[k] -> set_phn_end(k == end - 1);
+      }
+      const double* post = &posts[((size_t) start * span + end - start - 1) \
+        * cluster_num];
+      int new_c;
+      double log_marginal;
+      new_c = sample_index_from_log_distribution(post, cluster_num, \
+        &log_marginal);
+      if (context -> semiring != SEMIRING_SUM) {
+         memcpy(weights, post, sizeof(double) * cluster_num);
+         log_marginal = combine_scores(weights, cluster_num);
+      }
+      new_segment -> set_hash(log_marginal);
+      sample_more_than_cluster(*new_segment, clusters, clusters[new_c]);
+      new_segment -> change_hash_status(false);
+      segments.push_back(new_segment);
+      change_segment_num(1);
+      start = end;
+   }
+
+   // clusters only go once the new segments are counted
+   for (unsigned int n = 0; n < old_segments.size(); ++n) {
+      clean_cluster(old_segments[n], clusters);
+      delete old_segments[n];
+   }
+   return true;
+}
+
 void Sampler::is_boundary(Segment* h1_l, Segment* h1_r, \
                           Segment* h0, \
                           list<Segment*>& segments, \
-                          vector<Cluster*>& clusters, \
+                          ClusterRegistry& clusters, \
                           SampleBoundInfo& info, \
                           vector<Bound*>::iterator iter) {
 
@@ -252,10 +405,10 @@ void Sampler::is_boundary(Segment* h1_l, Segment* h1_r, \
       (*iter_members) -> set_parent(h1_r);
    }
    segments.push_front(h1_r);
-   Segment::counter += 2;
+   change_segment_num(2);
    (*iter) -> set_phn_end(true);
    h1_l -> change_hash_status(false);
-   h1_r -> change_has_status(false); // is there a reason not to do this?
+   h1_r -> change_hash_status(false); // is there a reason not to do this?
 
    if (h0 -> is_hashed()) {
       if (!clean_cluster(h0, clusters)) {
@@ -270,7 +423,7 @@ void Sampler::is_boundary(Segment* h1_l, Segment* h1_r, \
 void Sampler::is_not_boundary(Segment* h1_l, Segment* h1_r, \
                              Segment* h0, \
                              list<Segment*>& segments, \
-                             vector<Cluster*>& clusters, \
+                             ClusterRegistry& clusters, \
                              SampleBoundInfo& info,
                              vector<Bound*>::iterator iter) {
    if (h0 -> is_hashed()) {
@@ -286,7 +439,7 @@ void Sampler::is_not_boundary(Segment* h1_l, Segment* h1_r, \
    for(; iter_members != members.end(); ++iter_members) {
       (*iter_members) -> set_parent(h0);
    }
-   Segment::counter++;
+   change_segment_num(1);
    (*iter) -> set_phn_end(false);
    if (h1_r -> is_hashed()) {
       if (!clean_cluster(h1_r, clusters)) {
@@ -308,16 +461,12 @@ void Sampler::is_not_boundary(Segment* h1_l, Segment* h1_r, \
 
 SampleBoundInfo Sampler::sample_h0_h1(Segment* h0, \
                  Segment* h1_l, Segment* h1_r, \
-                 vector<Cluster*>& clusters) {
+                 ClusterRegistry& clusters) {
    double boundary_posterior_arr[2];
    SampleBoundInfo info;
    Cluster* c_h0;
    if (h0 -> is_hashed()) {
-     for (unsigned int i = 0; i < clusters.size(); ++i) {
-       if(h0 -> get_cluster_id() == clusters[i] -> get_cluster_id()) {
-	 c_h0 = clusters[i];
-       }
-     }
+     c_h0 = clusters.find(h0 -> get_cluster_id());
    }
    else {
      if (h0 -> get_cluster_id() != -1) {
@@ -334,11 +483,7 @@ SampleBoundInfo Sampler::sample_h0_h1(Segment* h0, \
    info.set_c_h0(c_h0);
    Cluster* c_h1_l;
    if (h1_l -> is_hashed()) {
-      for (unsigned int i = 0; i < clusters.size(); ++i) {
-         if(h1_l -> get_cluster_id() == clusters[i] -> get_cluster_id()) {
-            c_h1_l = clusters[i];
-         }
-      }
+      c_h1_l = clusters.find(h1_l -> get_cluster_id());
       encluster(*h1_l, clusters, c_h1_l);
    }
    else {
@@ -357,11 +502,7 @@ SampleBoundInfo Sampler::sample_h0_h1(Segment* h0, \
 
    Cluster* c_h1_r;
    if (h1_r -> is_hashed()) {
-      for (unsigned int i = 0; i < clusters.size(); ++i) {
-         if(h1_r -> get_cluster_id() == clusters[i] -> get_cluster_id()) {
-            c_h1_r = clusters[i];
-         }
-      }
+      c_h1_r = clusters.find(h1_r -> get_cluster_id());
    }
    else {
       if (h1_r -> get_cluster_id() != -1 && \
@@ -380,25 +521,28 @@ SampleBoundInfo Sampler::sample_h0_h1(Segment* h0, \
    boundary_posterior_arr[0] += boundary_prior_log[0];
    boundary_posterior_arr[1] += boundary_prior_log[1];
 
-   vector<double> boundary_posterior(boundary_posterior_arr, 
-				     boundary_posterior_arr + 2);
-
    // sample the decision
    // for the picked one, add it to the list<Segment*>
    // sample hidden states 
    // append it to the cluster's member list.
    // delete the unused Segment*
    // set the boundary info to (*iter)
-   int boundary_decision = sample_index_from_log_distribution(boundary_posterior);
+   int boundary_decision = sample_index_from_log_distribution( \
+     boundary_posterior_arr, 2, NULL);
    info.set_boundary_decision(boundary_decision);
    return info;
 }
 
-Cluster* Sampler::sample_just_cluster(Segment& data, vector<Cluster*>& clusters){
+Cluster* Sampler::sample_just_cluster(Segment& data, ClusterRegistry& clusters){
    double prior = 0.0;
    double likelihood = 0.0;
    int num_clusters = clusters.size();
    double posterior_arr[num_clusters];
+   const double* scored = NULL;
+   if (span_cache != NULL) {
+      scored = span_cache -> find(data.get_first_bound_index(), \
+        data.get_last_bound_index(), num_clusters);
+   }
 
    // Compute posterior P(c|data, clusters) for each cluster
    // Original formulation: P(c|data, clusters) ~ P(data|c)P(c|clusters)
@@ -406,23 +550,40 @@ Cluster* Sampler::sample_just_cluster(Segment& data, vector<Cluster*>& clusters)
      // P(c|clusters)
      prior = get_non_dp_prior(clusters[i]);
      // P(data|c)
-     likelihood = clusters[i] -> compute_likelihood(data);
+     if (scored != NULL) {
+        likelihood = scored[i];
+     }
+     else {
+        likelihood = clusters[i] -> compute_likelihood(data);
+     }
      posterior_arr[i] = prior + likelihood;
    }
 
-   vector<double> posteriors(posterior_arr, posterior_arr + num_clusters);
-   int new_c = sample_index_from_log_distribution(posteriors);
-   data.set_hash(calculator.sum_logs(posterior_arr, num_clusters));
+   int new_c;
+   double log_marginal;
+   new_c = sample_index_from_log_distribution(posterior_arr, \
+     num_clusters, &log_marginal);
+   if (context -> semiring != SEMIRING_SUM) {
+      log_marginal = combine_scores(posterior_arr, num_clusters);
+   }
+   data.set_hash(log_marginal);
    return clusters[new_c];
 }
 
+double Sampler::combine_scores(double* scores, const int len) {
+   if (context -> semiring == SEMIRING_MAX) {
+      return MaxProduct::plus(calculator, scores, len);
+   }
+   return SumProduct::plus(calculator, scores, len);
+}
+
 Cluster* Sampler::sample_cluster_from_base() {
-   Cluster* new_cluster = new Cluster(state_num, dim);
+   Cluster* new_cluster = new Cluster(state_num, dim, context);
    sample_hmm_parameters(*new_cluster);
    return new_cluster;
 }
 
-void Sampler::sample_more_than_cluster(Segment& data, vector<Cluster*>& clusters, Cluster* picked_cluster) {
+void Sampler::sample_more_than_cluster(Segment& data, ClusterRegistry& clusters, Cluster* picked_cluster) {
   // sample hidden_states for the data
   //sample_hidden_states(data, picked_cluster);
   picked_cluster -> run_vitterbi(data);
@@ -430,70 +591,160 @@ void Sampler::sample_more_than_cluster(Segment& data, vector<Cluster*>& clusters
   // shouldn't happen wihtout dp 
   if (picked_cluster -> get_cluster_id() == -1) {
     picked_cluster -> set_cluster_id();
-    clusters.push_back(picked_cluster);
-    Cluster::counter++;
+    clusters.insert(picked_cluster);
+    context -> cluster_counter++;
+    if (span_cache != NULL) {
+       span_cache -> clear();
+    }
   }
   // update cluster ID
    data.set_cluster_id(picked_cluster -> get_cluster_id());
 
    // add data to cluster
-   picked_cluster -> append_member(&data);
+   add_member(&data, picked_cluster);
 
    data.change_hash_status(true);
 }
 
 void Sampler::encluster(Segment& data, \
-                        vector<Cluster*>& clusters, \
+                        ClusterRegistry& clusters, \
                         Cluster* picked_cluster) {
-   picked_cluster -> append_member(&data);
+   add_member(&data, picked_cluster);
 }
 
-int Sampler::sample_index_from_distribution(vector<double> posteriors) {
-   vector<double>::iterator iter;
+void Sampler::add_member(Segment* data, Cluster* model) {
+   if (delta == NULL) {
+      model -> append_member(data);
+      return;
+   }
+   delta -> change_member(model, data, 1);
+   model -> link_member(data);
+}
+
+void Sampler::drop_member(Segment* data, Cluster* model) {
+   if (delta == NULL) {
+      model -> remove_members(data);
+      return;
+   }
+   delta -> change_member(model, data, -1);
+   if (data -> get_owner() == model) {
+      model -> unlink_member(data);
+   }
+}
+
+void Sampler::change_segment_num(const int d) {
+   if (delta == NULL) {
+      context -> segment_counter += d;
+   }
+   else {
+      delta -> change_segment_num(d);
+   }
+}
+
+// Index of the first cdf entry above target. cdf must be increasing;
+// short tables are walked, long ones bisected.
+static int search_cdf(const double* cdf, const int len, const double target) {
+   if (len <= LINEAR_SEARCH_MAX) {
+      int i = 0;
+      while (i < len - 1 && target > cdf[i]) {
+         ++i;
+      }
+      return i;
+   }
+   int lo = 0;
+   int hi = len - 1;
+   while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (target > cdf[mid]) {
+         lo = mid + 1;
+      }
+      else {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+int Sampler::sample_index_from_distribution(const vector<double>& weights) {
+   return sample_index_from_distribution(&weights[0], weights.size());
+}
+
+int Sampler::sample_index_from_distribution(const double* weights, \
+                                            const int len) {
+   // unnormalized prefix sums; the uniform is scaled instead
+   double cdf[len];
    double sum = 0.0;
-   int new_c = 0;
-   double random_from_unit = -1;
-   for(iter = posteriors.begin(); iter != posteriors.end(); ++iter) {
-      sum += *iter;
+   for (int i = 0; i < len; ++i) {
+      sum += weights[i];
+      cdf[i] = sum;
+   }
+   return search_cdf(cdf, len, sample_from_unit() * sum);
+}
+
+int Sampler::sample_index_from_log_distribution(const vector<double>& log_weights) {
+   return sample_index_from_log_distribution(&log_weights[0], \
+     log_weights.size(), NULL);
+}
+
+int Sampler::sample_index_from_log_distribution(const double* log_weights, \
+                                                const int len, \
+                                                double* log_sum) {
+   double marginal_max = log_weights[0];
+   for (int i = 1; i < len; ++i) {
+      if (log_weights[i] > marginal_max) {
+         marginal_max = log_weights[i];
+      }
    }
-   for(iter = posteriors.begin(); iter != posteriors.end(); ++iter) {
-      *iter /= sum; 
+   // exponentiate and accumulate in one pass, no normalization
+   double cdf[len];
+   double sum = 0.0;
+   for (int i = 0; i < len; ++i) {
+      sum += exp(log_weights[i] - marginal_max);
+      cdf[i] = sum;
    }
-   // sample a random number from a uniform dist [0,1]
-   random_from_unit = sample_from_unit(); 
-   // figure out the new cluster 
-   sum = posteriors[new_c];
-   while (random_from_unit > sum) {
-      sum += posteriors[++new_c];
+   if (log_sum != NULL) {
+      *log_sum = marginal_max + log(sum);
    }
-   return new_c;
+   return search_cdf(cdf, len, sample_from_unit() * sum);
 }
 
-int Sampler::sample_index_from_log_distribution(vector<double> posteriors) {
-   double marginal_max = calculator.find_log_max(posteriors);
-   // Normalize the poteriors first
+void Sampler::sample_indices_from_log_distribution(const double* log_weights, \
+                                                   const int len, \
+                                                   const int draws, \
+                                                   int* indices) {
+   double marginal_max = log_weights[0];
+   for (int i = 1; i < len; ++i) {
+      if (log_weights[i] > marginal_max) {
+         marginal_max = log_weights[i];
+      }
+   }
+   double cdf[len];
    double sum = 0.0;
-   double random_from_unit = -1;
-   int new_c = 0;
-   vector<double>::iterator iter;
-   for(iter = posteriors.begin(); iter != posteriors.end(); ++iter) {
-      *iter = exp(*iter - marginal_max);
-      sum += *iter;
+   for (int i = 0; i < len; ++i) {
+      sum += exp(log_weights[i] - marginal_max);
+      cdf[i] = sum;
    }
-   for(iter = posteriors.begin(); iter != posteriors.end(); ++iter) {
-      *iter /= sum; 
+   float units[draws];
+   fill_unit(units, draws);
+   for (int d = 0; d < draws; ++d) {
+      indices[d] = search_cdf(cdf, len, units[d] * sum);
    }
-   // sample a random number from a uniform dist [0,1]
-   random_from_unit = sample_from_unit(); 
-   // figure out the new cluster 
-   sum = posteriors[new_c];
-   while (random_from_unit > sum) {
-      sum += posteriors[++new_c];
+}
+
+void Sampler::fill_unit(float* units, const int len) {
+   if (use_counter_rng) {
+      counter_stream.fill_unit(units, len);
+      return;
+   }
+   for (int i = 0; i < len; ++i) {
+      units[i] = sample_from_unit();
    }
-   return new_c;
 }
 
 float Sampler::sample_from_unit() {
+   if (use_counter_rng) {
+      return counter_stream.sample_from_unit();
+   }
    float* ran_num;
    ran_num = storage.get_random_samples(UNIT);
    while (*ran_num == 1 || *ran_num == 0) {
@@ -529,8 +780,7 @@ const float* Sampler::sample_from_gamma_for_multidim(const float* count, \
    float total = 0.0;
     cout << "sampling for weight" << endl;
    for (int i = 0; i < multidim; ++i) {
-      vsRngGamma(GAMMA_METHOD, stream, 1, portion + i, \
-        prior[i] + count[i], 0, 1);
+      rng -> gamma(portion + i, 1, prior[i] + count[i], 1);
       total += portion[i]; 
    }
    for (int i = 0 ; i < multidim; ++i) {
@@ -540,80 +790,98 @@ const float* Sampler::sample_from_gamma_for_multidim(const float* count, \
 }
 
 
-void Sampler::sample_trans(vector<vector<float> >& trans, \
-                           vector<vector<float> >& pseudo_trans) {
+int Sampler::get_trans_row_prior(const int row, float* trans_prior) const {
+   int num_to_states;
    if (!SKIP) {
-      for(int i = 0; i < state_num; ++i) {
-         int num_to_states = 2; 
-         float counts[num_to_states];
-         for (int j = 0; j < num_to_states; ++j) {
-            counts[j] = pseudo_trans[i][i + j];
-         }
-         float trans_prior[num_to_states];
-         for (int j = 0; j < num_to_states; ++j) {
-            trans_prior[j] = gamma_trans_alpha;
-         }
-         if (i == 1) {
-            trans_prior[0] = 5 * gamma_trans_alpha;
-         }
-         const float* new_trans = sample_from_gamma_for_multidim( \
-            counts, num_to_states, trans_prior);
-         vector<float> new_state_trans(new_trans, new_trans + num_to_states);
-         for (int j = 0; j < num_to_states; ++j) {
-            new_state_trans[j] = log(new_state_trans[j]);
-         }
-         delete[] new_trans;
-         vector<float>::iterator iter;
-         for (int j = 0; j < i; ++j) {
-            iter = new_state_trans.begin();
-            new_state_trans.insert(iter, 0.0); 
-         }
-         if (i != state_num - 1 && i != 0) {
-            new_state_trans.push_back(0.0);
-         }
-         trans.push_back(new_state_trans);
+      num_to_states = 2; 
+      for (int j = 0; j < num_to_states; ++j) {
+         trans_prior[j] = gamma_trans_alpha;
+      }
+      if (row == 1) {
+         trans_prior[0] = 5 * gamma_trans_alpha;
       }
    }
    else {
-      for(int i = 0; i < state_num; ++i) {
-         int num_to_states = state_num - i;
-         if (i == state_num - 1) {
-            ++num_to_states;
-         }
-         if (i == 0) {
-            ++num_to_states;
-         }
-         float counts[num_to_states];
-         for (int j = 0; j < num_to_states; ++j) {
-            counts[j] = pseudo_trans[i][i + j];
-         }
-         float trans_prior[num_to_states];
-         for (int j = 0; j < num_to_states; ++j) {
-            trans_prior[j] = gamma_trans_alpha;
-         }
-         if (i == 0) {
-            trans_prior[0] = 3 * gamma_trans_alpha;
-            trans_prior[1] = 3 * gamma_trans_alpha;
-         }
-         else if (i == 1) {
-            trans_prior[0] = 3 * gamma_trans_alpha;
-         }
-         const float* new_trans = sample_from_gamma_for_multidim( \
-            counts, num_to_states, trans_prior);
-         vector<float> new_state_trans(new_trans, new_trans + num_to_states);
-         for (int j = 0; j < num_to_states; ++j) {
-            new_state_trans[j] = log(new_state_trans[j]);
-         }
-         delete[] new_trans;
-         vector<float>::iterator iter;
-         for (int j = 0; j < i; ++j) {
-            iter = new_state_trans.begin();
-            new_state_trans.insert(iter, 0.0); 
-         }
-         if (i != state_num - 1 && i != 0) {
-            new_state_trans.push_back(0.0);
+      num_to_states = state_num - row;
+      if (row == state_num - 1) {
+         ++num_to_states;
+      }
+      if (row == 0) {
+         ++num_to_states;
+      }
+      for (int j = 0; j < num_to_states; ++j) {
+         trans_prior[j] = gamma_trans_alpha;
+      }
+      if (row == 0) {
+         trans_prior[0] = 3 * gamma_trans_alpha;
+         trans_prior[1] = 3 * gamma_trans_alpha;
+      }
+      else if (row == 1) {
+         trans_prior[0] = 3 * gamma_trans_alpha;
+      }
+   }
+   return num_to_states;
+}
+
+void Sampler::sample_trans(vector<vector<float> >& trans, \
+                           vector<vector<float> >& pseudo_trans) {
+   for(int i = 0; i < state_num; ++i) {
+      float trans_prior[state_num + 1];
+      int num_to_states = get_trans_row_prior(i, trans_prior);
+      float counts[num_to_states];
+      for (int j = 0; j < num_to_states; ++j) {
+         counts[j] = pseudo_trans[i][i + j];
+      }
+      const float* new_trans = sample_from_gamma_for_multidim( \
+         counts, num_to_states, trans_prior);
+      vector<float> new_state_trans(new_trans, new_trans + num_to_states);
+      for (int j = 0; j < num_to_states; ++j) {
+         new_state_trans[j] = log(new_state_trans[j]);
+      }
+      delete[] new_trans;
+      vector<float>::iterator iter;
+      for (int j = 0; j < i; ++j) {
+         iter = new_state_trans.begin();
+         new_state_trans.insert(iter, 0.0); 
+      }
+      if (i != state_num - 1 && i != 0) {
+         new_state_trans.push_back(0.0);
+      }
+      trans.push_back(new_state_trans);
+   }
+}
+
+void Sampler::sample_hmm_parameters(Cluster& model, RngStream& stream) const {
+   float table[state_num * (state_num + 1)];
+   draw_trans(model.get_cache_trans(), model.get_cluster_id() == -1, \
+     stream, table);
+   model.set_trans(table);
+}
+
+void Sampler::draw_trans(const vector<vector<float> >& counts, \
+                         const bool from_prior, \
+                         RngStream& stream, \
+                         float* table) const {
+   int row_len = state_num + 1;
+   int table_len = state_num * row_len;
+   float trans_prior[row_len];
+   for (int i = 0; i < table_len; ++i) {
+      table[i] = 0.0;
+   }
+   for (int i = 0; i < state_num; ++i) {
+      int num_to_states = get_trans_row_prior(i, trans_prior);
+      float* row = table + i * row_len + i;
+      float total_row = 0.0;
+      for (int j = 0; j < num_to_states; ++j) {
+         float shape = trans_prior[j];
+         if (!from_prior) {
+            shape += counts[i][i + j];
          }
-         trans.push_back(new_state_trans);
+         row[j] = stream.sample_from_gamma(shape);
+         total_row += row[j];
+      }
+      for (int j = 0; j < num_to_states; ++j) {
+         row[j] = log(row[j] / total_row);
       }
    }
 }
@@ -642,11 +910,15 @@ void Sampler::sample_hmm_parameters(Cluster& model) {
 
 double Sampler::get_non_dp_prior(Cluster* model) const {
    int member_num = model->get_member_num();
-   int data_num = Segment::counter;
+   frame_index_t data_num = context -> segment_counter;
+   if (delta != NULL) {
+      member_num += delta -> get_member_num(model);
+      data_num += delta -> get_segment_num();
+   }
    if (member_num == 0) {
      return -300;
    }
-   return log((member_num / (data_num)));
+   return log((double) member_num / data_num);
 }
 
 void Sampler::init_prior(const int s_dim, \
@@ -675,11 +947,30 @@ void Sampler::init_prior(const int s_dim, \
    gamma_trans_alpha = s_gamma_trans_alpha;
    norm_kappa = s_norm_kappa;
    // generator.seed(static_cast<unsigned int>(time(0)));  
-   unsigned int SEED = time(0);
-   vslNewStream(&stream, BRNG,  SEED);
-   storage.init(dim, gamma_shape, norm_kappa, 1); 
+   if (!seed) {
+      seed = time(0);
+   }
+   cout << "Random seed " << seed << endl;
+   rng = RngBackend::create(seed);
+   cout << "Random number backend " << rng -> get_name() << endl;
+   // the storage streams take seed + 1 and seed + 2
+   storage.init(dim, gamma_shape, norm_kappa, 1, seed + 1); 
+   counter_stream.set_key(seed, 0, 0);
+}
+
+void Sampler::set_seed(const unsigned int s_seed) {
+   seed = s_seed;
+}
+
+void Sampler::set_stream_key(const unsigned int utterance, \
+                             const unsigned int iteration) {
+   counter_stream.set_key(seed, utterance, iteration);
+}
+
+void Sampler::set_pool_budget(const int megabytes) {
+   storage.set_pool_budget(static_cast<size_t>(megabytes) << 20);
 }
 
 Sampler::~Sampler() {
-   vslDeleteStream(&stream);
+   delete rng;
 }
@@ -17,7 +17,6 @@
 #ifndef SAMPLER_H
 #define SAMPLER_H
 
-#include <mkl_vsl.h>
 /*
 #include <boost/random/uniform_real.hpp> // for normal_distribution.
 #include <boost/random/mersenne_twister.hpp>
@@ -26,9 +25,15 @@
 */
 #include "segment.h"
 #include "cluster.h"
+#include "cluster_registry.h"
+#include "cluster_delta.h"
+#include "span_cache.h"
 #include "sample_boundary_info.h"
 #include "calculator.h"
 #include "storage.h"
+#include "rng_stream.h"
+#include "rng_backend.h"
+#include "run_context.h"
 
 using namespace std;
 // using namespace boost;
@@ -39,9 +44,8 @@ using namespace std;
 class Sampler {
    public:
       Sampler();
-      static int seed;
-      static float annealing;
-      static int offset;
+      // the run whose counters this sampler keeps; set before sampling
+      void set_context(RunContext* s_context) {context = s_context;}
       // set up priors for the model
       void init_prior(const int, \
         const int, \
@@ -49,27 +53,73 @@ class Sampler {
         const float, const float, \
         const float, const float, \
         const float, const float);
+      // per-pool memory budget of the random number storage, in MB
+      void set_pool_budget(const int);
+      // seed for every generator of this sampler, 0 picks one from the
+      // clock; must be set before init_prior
+      void set_seed(const unsigned int);
+      unsigned int get_seed() const {return seed;}
+      // draw uniforms from the counter-based stream of (utterance,
+      // iteration) instead of the shared pool
+      void set_counter_rng(const bool s) {use_counter_rng = s;}
+      bool get_counter_rng() const {return use_counter_rng;}
+      void set_stream_key(const unsigned int, const unsigned int);
+      // route count changes into a delta instead of the shared clusters,
+      // for sampling one utterance alongside others; NULL turns it off
+      void set_delta(ClusterDelta* s_delta) {delta = s_delta;}
+      // take segment likelihoods from the cache when their span has been
+      // scored ahead of time; NULL turns it off
+      void set_span_cache(SpanCache* s_cache) {span_cache = s_cache;}
       // sample the cluster for each segment
-      SampleBoundInfo sample_h0_h1(Segment*, Segment*, Segment*, vector<Cluster*>&);
+      SampleBoundInfo sample_h0_h1(Segment*, Segment*, Segment*, ClusterRegistry&);
       void is_boundary(Segment*, Segment*, Segment*, list<Segment*>& , \
-        vector<Cluster*>&, SampleBoundInfo&, vector<Bound*>::iterator);
+        ClusterRegistry&, SampleBoundInfo&, vector<Bound*>::iterator);
       void is_not_boundary(Segment*, Segment*, Segment*, list<Segment*>& , \
-        vector<Cluster*>&, SampleBoundInfo&, vector<Bound*>::iterator);
+        ClusterRegistry&, SampleBoundInfo&, vector<Bound*>::iterator);
       void sample_more_than_cluster(Segment&, \
-              vector<Cluster*>&, Cluster*);
-      Cluster* sample_just_cluster(Segment&, vector<Cluster*>&);
+              ClusterRegistry&, Cluster*);
+      Cluster* sample_just_cluster(Segment&, ClusterRegistry&);
       // sample cluster parameters
       void sample_hmm_parameters(Cluster&);
-      int sample_index_from_log_distribution(vector<double>);
-      int sample_index_from_distribution(vector<double>);
-      bool decluster(Segment*, vector<Cluster*>&);
-      bool clean_cluster(Segment*, vector<Cluster*>&);
+      // draw one cluster's table from a caller-owned stream; touches no
+      // sampler state, so it is safe to run for many clusters at once
+      void sample_hmm_parameters(Cluster&, RngStream&) const;
+      // draw a transition table in the layout of Cluster::set_trans from
+      // the given counts (ignored when drawing from the prior)
+      void draw_trans(const vector<vector<float> >&, const bool, \
+        RngStream&, float*) const;
+      int get_trans_row_prior(const int, float*) const;
+      // categorical draws over weights (or log weights) of length len;
+      // nothing is allocated and the weights are never normalized
+      int sample_index_from_log_distribution(const vector<double>&);
+      int sample_index_from_distribution(const vector<double>&);
+      int sample_index_from_distribution(const double*, const int);
+      // optionally returns log(sum(exp(w))) through the last argument
+      int sample_index_from_log_distribution(const double*, const int, \
+        double*);
+      // several independent draws from one distribution
+      void sample_indices_from_log_distribution(const double*, const int, \
+        const int, int*);
+      bool decluster(Segment*, ClusterRegistry&);
+      bool clean_cluster(Segment*, ClusterRegistry&);
       bool sample_boundary(Bound*);
+      // the same, with the given boundary probability for this bound
+      bool sample_boundary(Bound*, const float);
       bool sample_boundary(vector<Bound*>::iterator, \
-        list<Segment*>&, vector<Cluster*>&);
-      void encluster(Segment&, vector<Cluster*>&, Cluster*);
+        list<Segment*>&, ClusterRegistry&);
+      // resample every bound of the utterance starting at the given
+      // bound at once, with segments of at most the given number of
+      // bounds (0 for any); its segments must be at the front of the list
+      bool sample_utterance(vector<Bound*>::iterator, \
+        list<Segment*>&, ClusterRegistry&, const int);
+      void encluster(Segment&, ClusterRegistry&, Cluster*);
+      // count a segment in or out of a cluster, honouring the delta
+      void add_member(Segment*, Cluster*);
+      void drop_member(Segment*, Cluster*);
+      void change_segment_num(const int);
       // sample from unit distribution
       float sample_from_unit();
+      void fill_unit(float*, const int);
       // sample from a diagonal covariance 
       const float* sample_from_gamma(int, const float*, \
         const float*, const float);
@@ -78,11 +128,18 @@ class Sampler {
       const float* sample_from_gamma_for_multidim(const float*, int, float*);
       void sample_trans(vector<vector<float> >&, vector<vector<float> >&);
       Cluster* sample_cluster_from_base();
-      // Cluster* sample_from_hash_for_cluster(Segment*, vector<Cluster*>&);
+      // Cluster* sample_from_hash_for_cluster(Segment*, ClusterRegistry&);
       // get DP prior
       double get_non_dp_prior(Cluster*) const;
+      // the scores of the alternatives of a segment combined in the
+      // semiring of the run; reorders them
+      double combine_scores(double*, const int);
+      // log prior of a bound being a phone end or not
+      double get_boundary_log_prior(const bool phn_end) const \
+        {return boundary_prior_log[phn_end];}
       ~Sampler();
    private:
+      RunContext* context;
       int dim; 
       int state_num;
       float dp_alpha;
@@ -96,8 +153,13 @@ class Sampler {
       vector<double> boundary_prior_log;
       Calculator calculator;
       // base_generator_type generator;
-      VSLStreamStatePtr stream; 
+      RngBackend* rng; 
       Storage storage;
+      unsigned int seed;
+      bool use_counter_rng;
+      ClusterDelta* delta;
+      SpanCache* span_cache;
+      RngStream counter_stream;
       int UNIT;
       int MEAN;
       int PRE;
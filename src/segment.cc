@@ -18,11 +18,10 @@
 #include <fstream>
 #include <cstring>
 #include "segment.h"
+#include "cluster.h"
 
 using namespace std;
 
-int Segment::counter = 0;
-
 // initialize a segment by assigning default values to
 // frame_num
 // cluster_id
@@ -33,6 +32,7 @@ Segment::Segment(string tag_name, vector<Bound*> mem) {
    cluster_id = -1;
    tag = tag_name;
    members = mem;
+   context = members[0] -> get_context();
    set_frame_data();
    set_frame_likelihoods();
    set_frame_num();
@@ -42,6 +42,10 @@ Segment::Segment(string tag_name, vector<Bound*> mem) {
    dimension = members[0] -> get_dim();
    hidden_states = new int[frame_num];
    hashed = false;
+   hash_cluster_post = 0.0;
+   owner = NULL;
+   prev_member = NULL;
+   next_member = NULL;
 }
 
 const Segment& Segment::operator= (const Segment& source) {
@@ -51,6 +55,7 @@ const Segment& Segment::operator= (const Segment& source) {
    else {
       delete[] hidden_states;
    }
+   context = source.get_context();
    tag = source.get_tag();
    members = source.get_members();
    set_member_parent();
@@ -69,10 +74,15 @@ const Segment& Segment::operator= (const Segment& source) {
      sizeof(int) * frame_num);
    hashed = source.is_hashed();
    hash_cluster_post = source.get_hash();
+   // membership is not copied; the copy joins a cluster on its own
+   if (owner != NULL) {
+      owner -> unlink_member(this);
+   }
    return *this;
 }
 
 Segment::Segment(const Segment& source) {
+   context = source.get_context();
    tag = source.get_tag();
    start_frame = source.get_start_frame();
    end_frame = source.get_end_frame();
@@ -89,6 +99,9 @@ Segment::Segment(const Segment& source) {
      sizeof(int) * frame_num);
    hashed = source.is_hashed();
    hash_cluster_post = source.get_hash(); 
+   owner = NULL;
+   prev_member = NULL;
+   next_member = NULL;
 }
 
 void Segment::change_hash_status(bool new_status){
@@ -206,6 +219,17 @@ void Segment::write_class_label(const string& dir) {
 }
 
 // Free memories allocated for this object
+frame_index_t Segment::get_first_bound_index() const {
+   return members.front() -> get_index();
+}
+
+frame_index_t Segment::get_last_bound_index() const {
+   return members.back() -> get_index();
+}
+
 Segment::~Segment() {
+   if (owner != NULL) {
+      owner -> unlink_member(this);
+   }
    delete[] hidden_states;
 }
@@ -20,15 +20,16 @@
 #include <string>
 #include <vector>
 #include "bound.h"
+#include "run_context.h"
 
 using namespace std;
 class Bound;
+class Cluster;
 class Segment {
 public:
   Segment(const Segment&);
   Segment(string, vector<Bound*>);
   const Segment& operator= (const Segment&);
-  static int counter;
   void set_frame_num();
   void set_frame_data();
   void set_frame_likelihoods();
@@ -42,28 +43,43 @@ public:
   void write_class_label(const string&);
   vector<const float*> get_frame_data() const {return frame_data;}
   vector<const float*> get_frame_likelihoods() const {return frame_likelihoods;}
+  // the same, without the copy
+  const float* const* get_frame_likelihood_rows() const \
+    {return &frame_likelihoods[0];}
   int get_frame_num() const;
   const float* get_frame_i_data(int) const;
   const float* get_frame_i_likelihoods(int) const;
   int get_hidden_states(int) const;
   int get_cluster_id() const;
-  int get_frame_index(const int offset) const {return (start_frame_index + offset);}
+  frame_index_t get_frame_index(const int offset) const {return (start_frame_index + offset);}
   string get_tag() const {return tag;}
   int get_start_frame() const {return start_frame;}
   int get_end_frame() const {return end_frame;}
   int get_dimension() const {return dimension;}
   vector<Bound*> get_members() const {return members;}
+  frame_index_t get_first_bound_index() const;
+  frame_index_t get_last_bound_index() const;
   const int* get_hidden_states_all() const {return hidden_states;}
-  int get_segment_num() const {return counter;}
+  // the run of the bounds it is made of
+  RunContext* get_context() const {return context;}
+  frame_index_t get_segment_num() const {return context -> segment_counter;}
   bool is_hashed() const {return hashed;}
   void change_hash_status(bool);
   void set_hash(const double);
   double get_hash() const {return hash_cluster_post;} 
+  // intrusive links for the member list of the owning cluster
+  void set_owner(Cluster* s_owner) {owner = s_owner;}
+  void set_prev_member(Segment* s) {prev_member = s;}
+  void set_next_member(Segment* s) {next_member = s;}
+  Cluster* get_owner() const {return owner;}
+  Segment* get_prev_member() const {return prev_member;}
+  Segment* get_next_member() const {return next_member;}
   ~Segment();
 private:
+  RunContext* context;
   string tag;
   int start_frame;
-  int start_frame_index;
+  frame_index_t start_frame_index;
   int end_frame;
   int cluster_id;
   int frame_num;
@@ -75,6 +91,9 @@ private:
   bool hashed;
   // store cluster posterior
   double hash_cluster_post;
+  Cluster* owner;
+  Segment* prev_member;
+  Segment* next_member;
 };
 
 #endif
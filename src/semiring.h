@@ -0,0 +1,46 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./semiring.h
+ *	FILE: semiring.h                              *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef SEMIRING_H
+#define SEMIRING_H
+
+#include "calculator.h"
+
+// How segment scores combine alternatives (state paths, clusters):
+// sum-product adds them up, max-product keeps the best one, the Viterbi
+// approximation, with no exp or log.
+#define SEMIRING_SUM 0
+#define SEMIRING_MAX 1
+
+// Scores are logs, so the semiring product is + and only the sum
+// differs.
+struct SumProduct {
+   // sum_logs reorders the scores
+   static double plus(Calculator& calculator, double* scores, \
+                      const int len) {
+      return calculator.sum_logs(scores, len);
+   }
+};
+
+struct MaxProduct {
+   static double plus(Calculator&, double* scores, const int len) {
+      double best = scores[0];
+      for (int i = 1; i < len; ++i) {
+         best = scores[i] > best ? scores[i] : best;
+      }
+      return best;
+   }
+};
+
+#endif
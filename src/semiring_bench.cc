@@ -0,0 +1,95 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./semiring_bench.cc
+ *	FILE: semiring_bench.cc                       *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <ctime>
+#include <sys/stat.h>
+#include "manager.h"
+
+using namespace std;
+
+// Runs the same chain under sum-product and under max-product scoring,
+// and compares their speed and the boundaries they end up with.
+int main(int argc, char* argv[]) {
+   if (argc < 5) {
+      cout << "Usage:" << endl;
+      cout << "  ./semiring-bench [config-file] [data-list] [snapshot|\"\"] "
+           << "[gibbs-iter] [batch_size] [results-dir]" << endl;
+      return 1;
+   }
+   string config_file = argv[1];
+   string data_list = argv[2];
+   string snapshot = argv[3];
+   int gibbs_iter = atoi(argv[4]);
+   int batch_size = argc > 5 ? atoi(argv[5]) : 100;
+   string result_dir = argc > 6 ? argv[6] : "semiring_bench";
+   mkdir(result_dir.c_str(), 0755);
+
+   const char* names[] = {"sum-product", "max-product"};
+   const int semirings[] = {SEMIRING_SUM, SEMIRING_MAX};
+   Manager managers[2];
+   double seconds[2];
+   // both chains start from one seed, the clock's if none is configured
+   unsigned int seed = 0;
+   for (int m = 0; m < 2; ++m) {
+      Manager& manager = managers[m];
+      if (!manager.load_config(config_file)) {
+         cout << "Configuration file seems bad. Check " 
+              << config_file << " to make sure." << endl;
+         return -1;
+      }
+      if (!seed) {
+         seed = manager.get_seed() ? manager.get_seed() : time(NULL);
+      }
+      manager.set_seed(seed);
+      manager.set_semiring(semirings[m]);
+      manager.init_sampler();
+      bool loaded = snapshot != "" ? \
+        manager.load_snapshot(snapshot, data_list, batch_size) : \
+        manager.load_bounds(data_list, batch_size);
+      if (!loaded) {
+         cout << "Cannot load " << data_list << endl;
+         return -1;
+      }
+      string dir = result_dir + "/" + names[m];
+      mkdir(dir.c_str(), 0755);
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for (int i = 0; i <= gibbs_iter; ++i) {
+         if (!manager.run_iteration(i, dir)) {
+            return -1;
+         }
+      }
+      seconds[m] = chrono::duration<double>(chrono::steady_clock::now() - \
+        start).count();
+   }
+
+   frame_index_t bound_num = managers[0].get_bound_num();
+   frame_index_t agreed = 0;
+   for (frame_index_t b = 0; b < bound_num; ++b) {
+      agreed += managers[0].get_phn_end(b) == managers[1].get_phn_end(b);
+   }
+   for (int m = 0; m < 2; ++m) {
+      cout << names[m] << ": " << gibbs_iter + 1 << " iterations in " \
+           << seconds[m] << " s (" << (gibbs_iter + 1) / seconds[m] \
+           << " iterations/s), " << managers[m].get_segment_num() \
+           << " segments, " << managers[m].get_cluster_num() \
+           << " clusters" << endl;
+   }
+   cout << "Max-product speed-up " << seconds[0] / seconds[1] \
+        << ", boundary agreement " << (double) agreed / bound_num \
+        << " over " << bound_num << " bounds" << endl;
+   return 0;
+}
@@ -0,0 +1,76 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./span_cache.cc
+ *	FILE: span_cache.cc                           *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <cstddef>
+#include "span_cache.h"
+
+SpanCache::SpanCache() {
+   hits = 0;
+   misses = 0;
+}
+
+// A window holds a few dozen spans at most, so a linear scan will do.
+const double* SpanCache::find(const frame_index_t first, \
+                              const frame_index_t last, \
+                              const int cluster_num) {
+   for (unsigned int e = 0; e < firsts.size(); ++e) {
+      if (firsts[e] == first && lasts[e] == last && \
+          (int) scores[e].size() == cluster_num) {
+         ++hits;
+         return &scores[e][0];
+      }
+   }
+   ++misses;
+   return NULL;
+}
+
+bool SpanCache::contains(const frame_index_t first, \
+                         const frame_index_t last) const {
+   for (unsigned int e = 0; e < firsts.size(); ++e) {
+      if (firsts[e] == first && lasts[e] == last) {
+         return true;
+      }
+   }
+   return false;
+}
+
+int SpanCache::insert(const frame_index_t first, \
+                      const frame_index_t last, \
+                      const int cluster_num) {
+   firsts.push_back(first);
+   lasts.push_back(last);
+   scores.push_back(vector<double>(cluster_num, 0.0));
+   return scores.size() - 1;
+}
+
+void SpanCache::prune(const frame_index_t bound) {
+   unsigned int kept = 0;
+   for (unsigned int e = 0; e < firsts.size(); ++e) {
+      if (lasts[e] >= bound) {
+         firsts[kept] = firsts[e];
+         lasts[kept] = lasts[e];
+         scores[kept].swap(scores[e]);
+         ++kept;
+      }
+   }
+   firsts.resize(kept);
+   lasts.resize(kept);
+   scores.resize(kept);
+}
+
+void SpanCache::clear() {
+   firsts.clear();
+   lasts.clear();
+   scores.clear();
+}
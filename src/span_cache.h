@@ -0,0 +1,53 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./span_cache.h
+ *	FILE: span_cache.h                            *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef SPAN_CACHE_H
+#define SPAN_CACHE_H
+
+#include <vector>
+#include "frame_index.h"
+
+using namespace std;
+
+// Log likelihoods of a segment under every cluster, keyed by the index
+// of its first and last bound. Scores depend only on the frames and the
+// cluster parameters, so an entry stays good as long as the cluster set
+// does; the sampler clears the cache whenever that changes.
+class SpanCache {
+   public:
+      SpanCache();
+      // scores of the span, or NULL if it has not been scored for a set
+      // of cluster_num clusters
+      const double* find(const frame_index_t, const frame_index_t, const int);
+      bool contains(const frame_index_t, const frame_index_t) const;
+      // add a span with room for its scores and return its entry; the
+      // caller fills them in through get_scores once all are added
+      int insert(const frame_index_t, const frame_index_t, const int);
+      double* get_scores(const int e) {return &scores[e][0];}
+      // forget spans ending before the given bound
+      void prune(const frame_index_t);
+      void clear();
+      int get_hits() const {return hits;}
+      int get_misses() const {return misses;}
+      void reset_counts() {hits = 0; misses = 0;}
+      ~SpanCache() {};
+   private:
+      vector<frame_index_t> firsts;
+      vector<frame_index_t> lasts;
+      vector<vector<double> > scores;
+      int hits;
+      int misses;
+};
+
+#endif
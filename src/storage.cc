@@ -14,41 +14,62 @@
  *   Chia-ying (Jackie) Lee <chiaying@csail.mit.edu>				*
  *   Feb 2014							                            *
 *********************************************************************/
-#include <mkl_vsl.h>
-#include <ctime>
 #include <iostream>
 #include <cmath>
 #include "storage.h"
 
-#define BRNG VSL_BRNG_MT19937 
-#define GAMMA_METHOD VSL_RNG_METHOD_GAMMA_GNORM
-#define UNIFORM_METHOD VSL_RNG_METHOD_UNIFORM_STD
-#define GAUSSIAN_METHOD VSL_RNG_METHOD_GAUSSIAN_ICDF
+// default budget per pool: 16 MB
+#define POOL_BUDGET (16 << 20)
 
 using namespace std;
 
 Storage::Storage():UNIT(0), MEAN(1), PRE(2), EMIT(3) {
+   pool_budget = POOL_BUDGET;
+   batch_size = 0;
+   vector_batch_size = 0;
+   dim = 0;
+   gamma_rate = NULL;
+   prior_mean = NULL;
+   mean = NULL;
+   pre = NULL;
+   unit = NULL;
+   unit_spare = NULL;
+   emit = NULL;
+   rng = NULL;
+   unit_rng = NULL;
+   refill_wanted = false;
+   refill_stop = false;
+   spare_ready = false;
 }
 
 void Storage::init(const int s_dim, \
                 const int s_gamma_shape, \
                 const int s_norm_kappa, \
-                const float s_emit_gamma) {
-   batch_size = 10000000;
+                const float s_emit_gamma, \
+                const unsigned int seed) {
+   pool_budget = POOL_BUDGET;
+   batch_size = 0;
+   vector_batch_size = 0;
    dim = s_dim;
    gamma_shape = s_gamma_shape;
    norm_kappa = s_norm_kappa;
    emit_gamma_shape = s_emit_gamma;
-   mean = new float* [dim];
-   pre = new float* [dim];
-   unit = new float [batch_size];
-   emit = new float[batch_size];
+   gamma_rate = new float [dim];
+   prior_mean = new float [dim];
    for (int i = 0; i < dim; ++i) {
-      mean[i] = new float [batch_size];
-      pre[i] = new float [batch_size];
+      gamma_rate[i] = 1.0;
+      prior_mean[i] = 0.0;
    }
-   unsigned int SEED = time(0);
-   vslNewStream(&stream, BRNG,  SEED);
+   mean = NULL;
+   pre = NULL;
+   unit = NULL;
+   unit_spare = NULL;
+   emit = NULL;
+   refill_wanted = false;
+   refill_stop = false;
+   spare_ready = false;
+   rng = RngBackend::create(seed);
+   unit_rng = RngBackend::create(seed + 1);
    unit_index = 0;
    mean_index = 0;
    pre_index = 0;
@@ -58,27 +79,22 @@ void Storage::init(const int s_dim, \
 Storage::Storage(const int s_dim, \
                  const int s_gamma_shape, \
                  const int s_norm_kappa, \
-                 const float s_emit_gamma)
+                 const float s_emit_gamma, \
+                 const unsigned int seed)
                  :UNIT(0), MEAN(1), PRE(2), EMIT(3){
-   batch_size = 10000000;
-   dim = s_dim;
-   gamma_shape = s_gamma_shape;
-   norm_kappa = s_norm_kappa;
-   emit_gamma_shape = s_emit_gamma;
-   mean = new float* [dim];
-   pre = new float* [dim];
-   unit = new float [batch_size];
-   emit = new float [batch_size];
+   init(s_dim, s_gamma_shape, s_norm_kappa, s_emit_gamma, seed);
+}
+
+void Storage::set_pool_budget(const size_t s_pool_budget) {
+   pool_budget = s_pool_budget;
+}
+
+void Storage::set_prior(const float* s_gamma_rate, \
+                        const float* s_prior_mean) {
    for (int i = 0; i < dim; ++i) {
-      mean[i] = new float [batch_size];
-      pre[i] = new float [batch_size];
+      gamma_rate[i] = s_gamma_rate[i];
+      prior_mean[i] = s_prior_mean[i];
    }
-   unsigned int SEED = time(0);
-   vslNewStream(&stream, BRNG,  SEED);
-   unit_index = 0;
-   mean_index = 0;
-   pre_index = 0;
-   emit_index = 0;
 }
 
 void Storage::set_emit_gamma(const float new_gamma) {
@@ -86,17 +102,67 @@ void Storage::set_emit_gamma(const float new_gamma) {
    cout << "emit gamma shape " << emit_gamma_shape << endl;
 }
 
+void Storage::allocate_pool(const int TYPE) {
+   if (TYPE == UNIT || TYPE == EMIT) {
+      if (!batch_size) {
+         batch_size = pool_budget / sizeof(float);
+         if (batch_size < 1) {
+            batch_size = 1;
+         }
+      }
+      if (TYPE == UNIT) {
+         unit = new float [batch_size];
+         unit_spare = new float [batch_size];
+      }
+      else {
+         emit = new float [batch_size];
+      }
+   }
+   else if (TYPE == PRE || TYPE == MEAN) {
+      // MEAN is drawn from PRE, so both have rows of the same length
+      if (!vector_batch_size) {
+         vector_batch_size = pool_budget / (sizeof(float) * dim);
+         if (vector_batch_size < 1) {
+            vector_batch_size = 1;
+         }
+      }
+      float** pool = new float* [dim];
+      for (int i = 0; i < dim; ++i) {
+         pool[i] = new float [vector_batch_size];
+      }
+      if (TYPE == PRE) {
+         pre = pool;
+      }
+      else {
+         mean = pool;
+      }
+   }
+}
+
 float* Storage::get_random_samples(const int TYPE) {
    if (TYPE == UNIT) {
-      if (!(unit_index % batch_size)) {
+      if (unit == NULL) {
+         // fill the first buffer here, then let the refill thread keep
+         // the spare one ahead of us
+         allocate_pool(UNIT);
          sample_batch(UNIT);
          unit_index = 0;
+         refill_wanted = true;
+         refill_thread = thread(&Storage::refill_loop, this);
+      }
+      if (unit_index == batch_size) {
+         swap_unit_pool();
+         unit_index = 0;
       }
       float* sample = &unit[unit_index];
       ++unit_index;
       return sample; 
    }
    else if (TYPE == EMIT) {
+      if (emit == NULL) {
+         allocate_pool(EMIT);
+         emit_index = 0;
+      }
       if (!(emit_index % batch_size)) {
          sample_batch(EMIT);
          emit_index = 0;
@@ -106,7 +172,11 @@ float* Storage::get_random_samples(const int TYPE) {
       return sample; 
    }
    else if (TYPE == PRE) {
-      if (!(pre_index % batch_size)) {
+      if (pre == NULL) {
+         allocate_pool(PRE);
+         pre_index = 0;
+      }
+      if (!(pre_index % vector_batch_size)) {
          sample_batch(PRE);
          pre_index = 0;
       }
@@ -118,7 +188,11 @@ float* Storage::get_random_samples(const int TYPE) {
       return sample;
    }
    else if (TYPE == MEAN) {
-      if (!(mean_index % batch_size)) {
+      if (mean == NULL) {
+         allocate_pool(MEAN);
+         mean_index = 0;
+      }
+      if (!(mean_index % vector_batch_size)) {
          sample_batch(MEAN);
          mean_index = 0;
       }
@@ -135,29 +209,80 @@ float* Storage::get_random_samples(const int TYPE) {
    }
 }
 
+// Wait for the spare UNIT buffer and make it the active one
+void Storage::swap_unit_pool() {
+   if (!spare_ready.load(memory_order_acquire)) {
+      unique_lock<mutex> lock(refill_lock);
+      while (!spare_ready.load(memory_order_acquire)) {
+         ready_cond.wait(lock);
+      }
+   }
+   float* t = unit;
+   unit = unit_spare;
+   unit_spare = t;
+   spare_ready.store(false, memory_order_release);
+   lock_guard<mutex> lock(refill_lock);
+   refill_wanted = true;
+   refill_cond.notify_one();
+}
+
+void Storage::refill_loop() {
+   unique_lock<mutex> lock(refill_lock);
+   while (true) {
+      while (!refill_wanted && !refill_stop) {
+         refill_cond.wait(lock);
+      }
+      if (refill_stop) {
+         return;
+      }
+      refill_wanted = false;
+      lock.unlock();
+      unit_rng -> uniform(unit_spare, batch_size, 0, 1);
+      lock.lock();
+      spare_ready.store(true, memory_order_release);
+      ready_cond.notify_one();
+   }
+}
+
+void Storage::stop_refill() {
+   if (!refill_thread.joinable()) {
+      return;
+   }
+   {
+      lock_guard<mutex> lock(refill_lock);
+      refill_stop = true;
+      refill_cond.notify_one();
+   }
+   refill_thread.join();
+}
+
 void Storage::sample_batch(const int TYPE) {
-  const float* gamma_rate;
-  const float* prior_mean;
    if (TYPE == UNIT) {
-      vsRngUniform(UNIFORM_METHOD, stream, batch_size, unit, 0, 1);
+      unit_rng -> uniform(unit, batch_size, 0, 1);
    }
    else if (TYPE == EMIT) {
-      vsRngGamma(GAMMA_METHOD, stream, batch_size, emit, \
-        emit_gamma_shape, 0, 1);
+      rng -> gamma(emit, batch_size, emit_gamma_shape, 1);
    }
    else if (TYPE == PRE) {
      for (int i = 0; i < dim; ++i) {
-       cout << i << " gamma rate: " << gamma_rate[i] << endl;
-        vsRngGamma(GAMMA_METHOD, stream, batch_size, pre[i], \
-          gamma_shape, 0, 1 / gamma_rate[i]);
+        rng -> gamma(pre[i], vector_batch_size, gamma_shape, \
+          1 / gamma_rate[i]);
      }
    }
    else if (TYPE == MEAN) {
+     // each mean is drawn with the precision at the same position of
+     // the PRE pool, so make sure that pool exists
+     if (pre == NULL) {
+        allocate_pool(PRE);
+        sample_batch(PRE);
+        pre_index = 0;
+     }
+     // draw standard normals for a whole row, then scale and shift them
      for (int i = 0; i < dim; ++i) {
-        for (int j = 0; j < batch_size; ++j) {
+        rng -> gaussian(mean[i], vector_batch_size, 0, 1);
+        for (int j = 0; j < vector_batch_size; ++j) {
            float std = sqrt( 1 / (pre[i][j] * norm_kappa));
-           vsRngGaussian(GAUSSIAN_METHOD, \
-             stream, 1, &mean[i][j], prior_mean[i], std);
+           mean[i][j] = prior_mean[i] + mean[i][j] * std;
         }
      }
    }
@@ -167,13 +292,22 @@ void Storage::sample_batch(const int TYPE) {
 }
 
 Storage::~Storage() {
+   stop_refill();
    for (int i = 0; i < dim; ++i) {
-      delete[] mean[i];
-      delete[] pre[i];
+      if (mean != NULL) {
+         delete[] mean[i];
+      }
+      if (pre != NULL) {
+         delete[] pre[i];
+      }
    }
    delete[] mean;
    delete[] pre;
    delete[] unit;
+   delete[] unit_spare;
    delete[] emit;
-   vslDeleteStream(&stream);
+   delete[] gamma_rate;
+   delete[] prior_mean;
+   delete rng;
+   delete unit_rng;
 }
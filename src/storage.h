@@ -17,25 +17,55 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "rng_backend.h"
 
+using namespace std;
+
+// Pools of pre-drawn random numbers, one per stream type (UNIT, MEAN,
+// PRE, EMIT). A pool is allocated the first time its stream is used and
+// holds as many draws as fit in the pool budget; MEAN and PRE keep one
+// row per dimension, so their rows share the budget.
+// The UNIT pool is double buffered: a background thread refills the
+// spare buffer from its own stream while the active one is consumed,
+// so the sequence of uniforms for a given seed does not depend on when
+// the refill finishes.
 class Storage {
    public:
       Storage();
-      void init(const int, const int, const int, const float); 
-      Storage(const int, const int, const int, const float); 
+      void init(const int, const int, const int, const float, \
+        const unsigned int); 
+      Storage(const int, const int, const int, const float, \
+        const unsigned int); 
       void sample_batch(const int);
       void set_emit_gamma(const float);
+      // budget in bytes for each pool, applied to pools not yet allocated
+      void set_pool_budget(const size_t);
+      void set_prior(const float*, const float*);
       float* get_random_samples(const int);
       ~Storage();
    private:
+      void allocate_pool(const int);
+      void swap_unit_pool();
+      void refill_loop();
+      void stop_refill();
       int batch_size;
+      int vector_batch_size;
+      size_t pool_budget;
       int gamma_shape;
       float emit_gamma_shape;
       int norm_kappa;
       int dim;
+      float* gamma_rate;
+      float* prior_mean;
       float** mean;
       float** pre;
       float* unit;
+      float* unit_spare;
       float* emit;
       const int UNIT;
       const int MEAN;
@@ -45,7 +75,16 @@ class Storage {
       int mean_index;
       int pre_index;
       int emit_index;
-      VSLStreamStatePtr stream; 
+      RngBackend* rng; 
+      RngBackend* unit_rng; 
+      // handoff between the sampler and the refill thread
+      thread refill_thread;
+      mutex refill_lock;
+      condition_variable refill_cond;
+      condition_variable ready_cond;
+      bool refill_wanted;
+      bool refill_stop;
+      atomic<bool> spare_ready;
 };
 
 #endif
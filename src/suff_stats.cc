@@ -0,0 +1,79 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./suff_stats.cc
+ *	FILE: suff_stats.cc                           *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include <cstring>
+#include <stdint.h>
+#include "suff_stats.h"
+
+// floats per cache line
+#define LINE_FLOATS 16
+
+SuffStats::SuffStats(const int s_state_num, const int s_lane_num) {
+   state_num = s_state_num;
+   lane_num = s_lane_num;
+   member_num = 0;
+   for (int i = 0; i < state_num; ++i) {
+      vector<float> state_trans(state_num + 1, 0.0);
+      trans.push_back(state_trans);
+   }
+   shard_block = NULL;
+   shards = NULL;
+   stride = 0;
+   if (lane_num > 0) {
+      int table_len = state_num * (state_num + 1);
+      stride = (table_len + 2 + LINE_FLOATS - 1) / LINE_FLOATS * LINE_FLOATS;
+      // one spare line to align the start
+      shard_block = new float[lane_num * stride + LINE_FLOATS];
+      uintptr_t addr = reinterpret_cast<uintptr_t>(shard_block);
+      uintptr_t line = LINE_FLOATS * sizeof(float);
+      shards = reinterpret_cast<float*>((addr + line - 1) / line * line);
+      memset(shards, 0, sizeof(float) * lane_num * stride);
+   }
+}
+
+void SuffStats::publish(const int lane, \
+                        const float* s_trans, \
+                        const int s_member_num) {
+   int table_len = state_num * (state_num + 1);
+   float* shard = shards + lane * stride;
+   for (int k = 0; k < table_len; ++k) {
+      shard[k] += s_trans[k];
+   }
+   shard[table_len] += s_member_num;
+   shard[table_len + 1] = 1;
+}
+
+bool SuffStats::fold() {
+   int table_len = state_num * (state_num + 1);
+   bool changed = false;
+   for (int l = 0; l < lane_num && shards != NULL; ++l) {
+      float* shard = shards + l * stride;
+      if (shard[table_len + 1] == 0) {
+         continue;
+      }
+      for (int i = 0; i < state_num; ++i) {
+         for (int j = 0; j < state_num + 1; ++j) {
+            trans[i][j] += shard[i * (state_num + 1) + j];
+         }
+      }
+      member_num += (int) shard[table_len];
+      memset(shard, 0, sizeof(float) * (table_len + 2));
+      changed = true;
+   }
+   return changed;
+}
+
+SuffStats::~SuffStats() {
+   delete[] shard_block;
+}
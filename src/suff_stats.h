@@ -0,0 +1,63 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./suff_stats.h
+ *	FILE: suff_stats.h                            *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef SUFF_STATS_H
+#define SUFF_STATS_H
+
+#include <vector>
+
+using namespace std;
+
+// Transition counts and member count of one cluster.
+// Scoring and priors read the folded counts, which only the thread that
+// owns the cluster set changes directly. Threads sampling in parallel
+// publish into shards instead, one per lane, each padded to whole cache
+// lines so that lanes never write the same line and need no lock. The
+// folded counts stay fixed, and so consistent for every reader, until
+// fold() adds the shards in.
+class SuffStats {
+   public:
+      // state_num, and the number of lanes that can publish
+      SuffStats(const int, const int);
+      // folded counts
+      int get_member_num() const {return member_num;}
+      void set_member_num(const int s) {member_num = s;}
+      float get_trans(const int i, const int j) const {return trans[i][j];}
+      vector<vector<float> >& get_trans() {return trans;}
+      const vector<vector<float> >& get_trans() const {return trans;}
+      void add_trans(const int i, const int j, const float d) {trans[i][j] += d;}
+      void add_member_num(const int d) {member_num += d;}
+      // add a state_num x (state_num + 1) table of transition count
+      // changes and a member count change to the lane's shard
+      void publish(const int, const float*, const int);
+      // add every published shard to the folded counts and clear it;
+      // returns whether anything was published
+      bool fold();
+      ~SuffStats();
+   private:
+      // the shards are owned, so no copies
+      SuffStats(const SuffStats&) = delete;
+      SuffStats& operator=(const SuffStats&) = delete;
+      int state_num;
+      int lane_num;
+      int member_num;
+      vector<vector<float> > trans;
+      // lane l starts at shards + l * stride: the table, then the member
+      // count change, then a published flag
+      float* shard_block;
+      float* shards;
+      int stride;
+};
+
+#endif
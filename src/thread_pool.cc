@@ -0,0 +1,93 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./thread_pool.cc
+ *	FILE: thread_pool.cc                          *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool() {
+   task = NULL;
+   task_size = 0;
+   next_index = 0;
+   busy = 0;
+   generation = 0;
+   stop = false;
+}
+
+void ThreadPool::init(const int thread_num) {
+   for (int l = 1; l < thread_num; ++l) {
+      workers.push_back(thread(&ThreadPool::worker_loop, this, l));
+   }
+}
+
+void ThreadPool::run_indices(const int lane) {
+   int i;
+   while ((i = next_index.fetch_add(1)) < task_size) {
+      task -> run(i, lane);
+   }
+}
+
+void ThreadPool::worker_loop(const int lane) {
+   unsigned int seen = 0;
+   unique_lock<mutex> lock(pool_lock);
+   while (true) {
+      while (generation == seen && !stop) {
+         work_cond.wait(lock);
+      }
+      if (stop) {
+         return;
+      }
+      seen = generation;
+      lock.unlock();
+      run_indices(lane);
+      lock.lock();
+      if (--busy == 0) {
+         done_cond.notify_one();
+      }
+   }
+}
+
+void ThreadPool::parallel_for(const int n, PoolTask& s_task) {
+   if (workers.empty() || n <= 1) {
+      for (int i = 0; i < n; ++i) {
+         s_task.run(i, 0);
+      }
+      return;
+   }
+   unique_lock<mutex> lock(pool_lock);
+   task = &s_task;
+   task_size = n;
+   next_index = 0;
+   busy = workers.size();
+   ++generation;
+   lock.unlock();
+   work_cond.notify_all();
+   run_indices(0);
+   // every worker checks in, even one that found nothing left to do,
+   // before the task may go out of scope
+   lock.lock();
+   while (busy) {
+      done_cond.wait(lock);
+   }
+   task = NULL;
+}
+
+ThreadPool::~ThreadPool() {
+   {
+      lock_guard<mutex> lock(pool_lock);
+      stop = true;
+   }
+   work_cond.notify_all();
+   for (unsigned int l = 0; l < workers.size(); ++l) {
+      workers[l].join();
+   }
+}
@@ -0,0 +1,61 @@
+/* -*- C++ -*-
+ *
+ * Copyright (c) 2014
+ * Spoken Language Systems Group
+ * MIT Computer Science and Artificial Intelligence Laboratory
+ * Massachusetts Institute of Technology
+ *
+ * All Rights Reserved
+
+./thread_pool.h
+ *	FILE: thread_pool.h                           *
+ *										                            *
+ *   				      				                            * 
+*********************************************************************/
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace std;
+
+// One unit of parallel work. run() is called once per index with the
+// lane (0 .. thread_num - 1) of the thread doing the call, so tasks can
+// keep per-lane scratch space without locking.
+class PoolTask {
+   public:
+      virtual void run(const int, const int) = 0;
+      virtual ~PoolTask() {};
+};
+
+// Fixed set of worker threads. The calling thread works as lane 0, and
+// indices are handed out one at a time so uneven tasks balance out.
+class ThreadPool {
+   public:
+      ThreadPool();
+      // start thread_num - 1 workers; 1 or less runs everything inline
+      void init(const int);
+      int get_thread_num() const {return workers.size() + 1;}
+      // run task for every index in [0, n) and wait for all of them
+      void parallel_for(const int, PoolTask&);
+      ~ThreadPool();
+   private:
+      void worker_loop(const int);
+      void run_indices(const int);
+      vector<thread> workers;
+      mutex pool_lock;
+      condition_variable work_cond;
+      condition_variable done_cond;
+      PoolTask* task;
+      int task_size;
+      atomic<int> next_index;
+      int busy;
+      unsigned int generation;
+      bool stop;
+};
+
+#endif